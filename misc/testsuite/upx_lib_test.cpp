@@ -0,0 +1,95 @@
+/* upx_lib_test.cpp -- pack and unpack a file in memory with upx_lib
+
+   This file is part of the UPX executable compressor.
+
+   Copyright (C) 1996-2024 Markus Franz Xaver Johannes Oberhumer
+   Copyright (C) 1996-2024 Laszlo Molnar
+   All Rights Reserved.
+
+   UPX and the UCL library are free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+   Markus F.X.J. Oberhumer              Laszlo Molnar
+   <markus@oberhumer.com>               <ezerotven+github@gmail.com>
+ */
+
+// usage: upx_lib_test FILE
+//   FILE must be an executable of a format supported by UPX; see the
+//   upx-lib-pack test in CMakeLists.txt
+
+#include "upx_lib.h"
+
+static void run(const char *name, int cmd, const MemBuffer &in, unsigned in_len,
+                MemBuffer &out, unsigned *out_len) may_throw {
+    Options o;
+    o.reset();
+    o.cmd = cmd;
+    o.level = 1;
+    o.verbose = 0;
+    *out_len = do_one_memory_file(&o, name, in, in_len, out);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s FILE\n", argv[0]);
+        return EXIT_USAGE;
+    }
+    const char *const name = argv[1];
+    if (upx_lib_init() != 0) {
+        fprintf(stderr, "%s: upx_lib_init failed\n", argv[0]);
+        return EXIT_INIT;
+    }
+
+    FILE *f = fopen(name, "rb");
+    if (f == nullptr) {
+        fprintf(stderr, "%s: cannot open '%s'\n", argv[0], name);
+        return EXIT_ERROR;
+    }
+    MemBuffer in;
+    unsigned in_len = 0;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        long n = ftell(f);
+        if (n > 0 && mem_size_valid_bytes(n)) {
+            in_len = (unsigned) n;
+            in.alloc(in_len);
+            if (fseek(f, 0, SEEK_SET) != 0 || fread(in, 1, in_len, f) != in_len)
+                in_len = 0;
+        }
+    }
+    fclose(f);
+    if (in_len == 0) {
+        fprintf(stderr, "%s: cannot read '%s'\n", argv[0], name);
+        return EXIT_ERROR;
+    }
+
+    try {
+        MemBuffer packed, unpacked, dummy;
+        unsigned packed_len = 0, unpacked_len = 0, dummy_len = 0;
+        run(name, CMD_COMPRESS, in, in_len, packed, &packed_len);
+        if (packed_len == 0 || packed_len >= in_len)
+            throwInternalError("bad packed size");
+        run(name, CMD_TEST, packed, packed_len, dummy, &dummy_len);
+        run(name, CMD_DECOMPRESS, packed, packed_len, unpacked, &unpacked_len);
+        if (unpacked_len <= packed_len)
+            throwInternalError("bad unpacked size");
+        printf("%s: %u -> %u -> %u bytes\n", name, in_len, packed_len, unpacked_len);
+    } catch (const Throwable &e) {
+        printErr(name, e);
+        return EXIT_ERROR;
+    }
+    return EXIT_OK;
+}
+
+/* vim:set ts=4 sw=4 et: */
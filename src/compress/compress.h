@@ -114,6 +114,13 @@ int upx_ucl_test_overlap   ( const upx_bytep buf,
                                    unsigned *dst_len,
                                    int method,
                              const upx_compress_result_t *cresult );
+// compress_ucl_fast.cpp: NRV2B and NRV2E only, used for low levels
+int upx_ucl_fast_compress  ( const upx_bytep src, unsigned  src_len,
+                                   upx_bytep dst, unsigned *dst_len,
+                                   upx_callback_t *cb,
+                                   int method, int level,
+                             const ucl_compress_config_t *cconf,
+                                   ucl_uint *res );
 unsigned upx_ucl_adler32(const void *buf, unsigned len, unsigned adler);
 unsigned upx_ucl_crc32  (const void *buf, unsigned len, unsigned crc);
 #endif
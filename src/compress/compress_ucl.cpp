@@ -128,6 +128,12 @@ int upx_ucl_compress(const upx_bytep src, unsigned src_len, upx_bytep dst, unsig
     else if (level == 4 && cconf.max_offset == UCL_UINT_MAX)
         cconf.max_offset = 32 * 1024 - 1;
 
+    if (level <= 2 && (M_IS_NRV2B(method) || M_IS_NRV2E(method))) {
+        // speed matters more than ratio here
+        return upx_ucl_fast_compress(src, src_len, dst, dst_len, cb_parm, method, level, &cconf,
+                                     res);
+    }
+
     if M_IS_NRV2B (method)
         r = ucl_nrv2b_99_compress(src, src_len, dst, dst_len, &cb, level, &cconf, res);
     else if M_IS_NRV2D (method)
@@ -0,0 +1,528 @@
+/* compress_ucl_fast.cpp -- fast NRV2B/NRV2E encoder for low levels
+
+   This file is part of the UPX executable compressor.
+
+   Copyright (C) 1996-2024 Markus Franz Xaver Johannes Oberhumer
+   All Rights Reserved.
+
+   UPX and the UCL library are free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+   Markus F.X.J. Oberhumer
+   <markus@oberhumer.com>
+ */
+
+// ucl_nrv2[be]_99_compress() is tuned for ratio and stays slow even at
+// level 1. This is a plain hash-chain matcher instead: greedy at level 1,
+// with one step of lazy evaluation at level 2. It writes an ordinary
+// NRV2B or NRV2E stream, so the UCL decompressors and all runtime stubs
+// can decode it.
+
+#include "../conf.h"
+#include "compress.h"
+#include "../util/membuffer.h"
+
+#if (WITH_UCL)
+
+namespace {
+
+enum : unsigned {
+    HASH_BITS = 15,
+    MIN_MATCH = 3,
+    M3_MAX_OFFSET = 0x8000,       // a longer offset makes a 3-byte match expand
+    MAX_WINDOW = 1024 * 1024 - 1, // limits the size of the chain buffer
+};
+
+// Bits are written MSB first into 8-, 16- or 32-bit little-endian words.
+// A word is reserved in the output when its first bit gets written, so
+// bits and bytes interleave exactly as the decompressors read them.
+struct BitWriter final {
+    byte *out;
+    unsigned op = 0;
+    unsigned bb_pos = 0;
+    unsigned bb = 0;
+    unsigned bb_free = 0; // bits left in the current word
+    unsigned bb_size;
+
+    explicit BitWriter(byte *o, unsigned size) noexcept : out(o), bb_size(size) {}
+
+    void putByte(unsigned b) noexcept { out[op++] = (byte) b; }
+    void putBit(unsigned b) noexcept {
+        if (bb_free == 0) {
+            bb_pos = op;
+            op += bb_size / 8;
+            bb = 0;
+            bb_free = bb_size;
+        }
+        bb |= b << --bb_free;
+        if (bb_free == 0)
+            storeWord();
+    }
+    // write the lowest n bits of v, MSB first
+    void putBits(unsigned v, unsigned n) noexcept {
+        while (n-- > 0)
+            putBit((v >> n) & 1);
+    }
+    void flush() noexcept {
+        if (bb_free != 0)
+            storeWord();
+        bb_free = 0;
+    }
+
+    // "m = 1; do m = 2 * m + getbit(); while (!getbit())"; v >= 2
+    void putGamma(unsigned v) noexcept {
+        unsigned n = 1;
+        while ((v >> n) > 1)
+            n++;
+        while (n-- > 0) {
+            putBit((v >> n) & 1);
+            putBit(n == 0);
+        }
+    }
+    // the NRV2E offset prefix: "m = 1; for (;;) { m = 2 * m + getbit();
+    // if (getbit()) break; m = 2 * (m - 1) + getbit(); }"; v >= 2
+    void putSS12(unsigned v) noexcept {
+        unsigned bits[3 * 32];
+        unsigned n = 0;
+        unsigned u = v >> 1;
+        bits[n++] = 1;
+        bits[n++] = v & 1;
+        while (u != 1) { // built backwards
+            const unsigned t = (u >> 1) + 1;
+            bits[n++] = u & 1;
+            bits[n++] = 0;
+            bits[n++] = t & 1;
+            u = t >> 1;
+        }
+        while (n > 0)
+            putBit(bits[--n]);
+    }
+
+private:
+    void storeWord() noexcept {
+        if (bb_size == 8)
+            out[bb_pos] = (byte) bb;
+        else if (bb_size == 16)
+            set_le16(out + bb_pos, bb);
+        else
+            set_le32(out + bb_pos, bb);
+    }
+};
+
+struct Match final {
+    unsigned len;
+    unsigned off;
+};
+
+struct Matcher final {
+    const byte *const in;
+    const unsigned in_len;
+    const unsigned max_offset;
+    const unsigned max_match;
+    const unsigned max_chain;
+    const unsigned wmask;
+    unsigned *head = nullptr;
+    unsigned *chain = nullptr; // positions + 1, so that 0 means empty
+    unsigned inserted = 0;     // all positions below this are hashed
+
+    Matcher(const byte *i, unsigned l, unsigned mo, unsigned mm, unsigned mc, unsigned wm) noexcept
+        : in(i), in_len(l), max_offset(mo), max_match(mm), max_chain(mc), wmask(wm) {}
+
+    static forceinline unsigned hash(const byte *p) noexcept {
+        const unsigned v = p[0] | (p[1] << 8) | (p[2] << 16);
+        return (v * 0x9e3779b1u) >> (32 - HASH_BITS);
+    }
+
+    // length of the common prefix of a and b, at most limit
+    forceinline unsigned matchLength(const byte *a, const byte *b, unsigned limit) const noexcept {
+        unsigned l = 0;
+        while (l + 8 <= limit) {
+            const upx_uint64_t x = get_le64(a + l) ^ get_le64(b + l);
+            if (x != 0) {
+#if __has_builtin(__builtin_ctzll)
+                return l + (unsigned) (__builtin_ctzll(x) >> 3);
+#else
+                break;
+#endif
+            }
+            l += 8;
+        }
+        while (l < limit && a[l] == b[l])
+            l++;
+        return l;
+    }
+
+    forceinline unsigned limitAt(unsigned pos) const noexcept {
+        return upx::umin(in_len - pos, max_match);
+    }
+
+    // hash all positions up to and including pos
+    forceinline void insertUpTo(unsigned pos) noexcept {
+        const unsigned end = upx::umin(pos + 1, in_len - MIN_MATCH + 1);
+        unsigned *const h_tab = head;
+        unsigned *const c_tab = chain;
+        unsigned i = inserted;
+        for (; i < end; i++) {
+            const unsigned h = hash(in + i);
+            c_tab[i & wmask] = h_tab[h];
+            h_tab[h] = i + 1;
+        }
+        inserted = i;
+    }
+
+    // longest match at pos from the hash chain
+    Match find(unsigned pos) noexcept {
+        Match m = {0, 0};
+        if (pos + MIN_MATCH > in_len)
+            return m;
+        insertUpTo(pos);
+        const unsigned limit = limitAt(pos);
+        const byte *const p = in + pos;
+        unsigned c = chain[pos & wmask];
+        for (unsigned n = max_chain; c != 0 && n > 0; n--) {
+            const unsigned cand = c - 1;
+            const unsigned off = pos - cand;
+            if (cand >= pos || off > max_offset)
+                break;
+            const byte *const q = in + cand;
+            if (q[m.len] == p[m.len]) { // quick reject
+                const unsigned l = matchLength(p, q, limit);
+                if (l > m.len) {
+                    m.len = l;
+                    m.off = off;
+                    if (l >= limit)
+                        break;
+                }
+            }
+            c = chain[cand & wmask];
+        }
+        // With at most 9 bits for every byte of input the output always
+        // fits into MemBuffer::getSizeForCompression().
+        if (m.len < MIN_MATCH || (m.len == MIN_MATCH && m.off > M3_MAX_OFFSET))
+            m.len = 0;
+        return m;
+    }
+
+    unsigned repLength(unsigned pos, unsigned off) const noexcept {
+        if (off > pos || off > max_offset)
+            return 0;
+        return matchLength(in + pos, in + pos - off, limitAt(pos));
+    }
+};
+
+template <bool NRV2E>
+int fast_compress(const byte *src, unsigned src_len, byte *dst, unsigned *dst_len,
+                  upx_callback_t *cb, int level, unsigned bb_size, unsigned max_offset,
+                  unsigned max_match, ucl_uint *res) {
+    const unsigned dst_size = *dst_len;
+    *dst_len = 0;
+
+    unsigned window = 1;
+    while (window <= max_offset + 1) // see Matcher::find()
+        window <<= 1;
+    MemBuffer head_buf(sizeof(unsigned) << HASH_BITS);
+    MemBuffer chain_buf(sizeof(unsigned) * window);
+    head_buf.clear();
+    chain_buf.clear();
+    Matcher mf(src, src_len, max_offset, max_match, level <= 1 ? 4 : 16, window - 1);
+    mf.head = (unsigned *) head_buf.getVoidPtr();
+    mf.chain = (unsigned *) chain_buf.getVoidPtr();
+
+    // lengths are sent as "len - 1", minus one more for far offsets
+    const unsigned far_offset = NRV2E ? 0x500 : 0xd00;
+    BitWriter bw(dst, bb_size);
+    unsigned last_off = 1;
+    unsigned max_offset_found = 0, max_match_found = 0, max_run_found = 0;
+    unsigned first_offset_found = 0;
+    unsigned run = 0;
+    unsigned next_progress = 0;
+    unsigned pos = 0;
+    Match cur = mf.find(0);
+    while (pos < src_len) {
+        // generous worst case size of one literal or match
+        if (bw.op + 64 > dst_size)
+            return UPX_E_OUTPUT_OVERRUN;
+        if (cb && cb->nprogress && pos >= next_progress) {
+            cb->nprogress(cb, pos, bw.op);
+            next_progress = pos + 64 * 1024;
+        }
+
+        // a match at the last offset needs no offset byte
+        Match m = cur;
+        const unsigned rep_len = mf.repLength(pos, last_off);
+        if (rep_len >= (last_off > far_offset ? 3u : 2u) && rep_len + 1 >= m.len) {
+            m.len = rep_len;
+            m.off = last_off;
+        } else if (m.len != 0 && level >= 2) {
+            // lazy: rather send a literal if the next position does better
+            const Match next = mf.find(pos + 1);
+            if (next.len > m.len + 1 || (next.len > m.len && next.off <= m.off)) {
+                cur = next;
+                m.len = 0;
+            }
+        }
+
+        if (m.len == 0) {
+            bw.putBit(1);
+            bw.putByte(src[pos++]);
+            run += 1;
+            if (cur.len == 0)
+                cur = mf.find(pos);
+            continue;
+        }
+
+        bw.putBit(0);
+        const unsigned m_len = m.len - 1 - (m.off > far_offset ? 1 : 0);
+        if (m.off == last_off) {
+            if (NRV2E) {
+                bw.putSS12(2);
+                bw.putBit(m_len <= 2 ? 1 : 0);
+            } else
+                bw.putGamma(2);
+        } else {
+            const unsigned d = m.off - 1;
+            if (NRV2E) {
+                bw.putSS12((d >> 7) + 3);
+                bw.putByte(((d & 0x7f) << 1) | (m_len <= 2 ? 0 : 1));
+            } else {
+                bw.putGamma((d >> 8) + 3);
+                bw.putByte(d & 0xff);
+            }
+            last_off = m.off;
+        }
+        if (NRV2E) {
+            if (m_len <= 2)
+                bw.putBit(m_len - 1);
+            else if (m_len <= 4)
+                bw.putBits(2 + (m_len - 3), 2);
+            else {
+                bw.putBit(0);
+                bw.putGamma(m_len - 3);
+            }
+        } else {
+            if (m_len <= 3)
+                bw.putBits(m_len, 2);
+            else {
+                bw.putBits(0, 2);
+                bw.putGamma(m_len - 2);
+            }
+        }
+
+        if (first_offset_found == 0)
+            first_offset_found = m.off;
+        max_offset_found = upx::umax(max_offset_found, m.off);
+        max_match_found = upx::umax(max_match_found, m.len);
+        max_run_found = upx::umax(max_run_found, run);
+        run = 0;
+        pos += m.len;
+        cur = mf.find(pos);
+    }
+    max_run_found = upx::umax(max_run_found, run);
+
+    // end marker: an offset of 0xffffffff
+    if (bw.op + 64 > dst_size)
+        return UPX_E_OUTPUT_OVERRUN;
+    bw.putBit(0);
+    if (NRV2E)
+        bw.putSS12(0x1000002);
+    else
+        bw.putGamma(0x1000002);
+    bw.putByte(0xff);
+    bw.flush();
+
+    if (cb && cb->nprogress)
+        cb->nprogress(cb, src_len, bw.op);
+    *dst_len = bw.op;
+    res[1] = max_offset_found;
+    res[3] = max_match_found;
+    res[5] = max_run_found;
+    res[6] = first_offset_found;
+    return UPX_E_OK;
+}
+
+} // namespace
+
+/*************************************************************************
+//
+**************************************************************************/
+
+int upx_ucl_fast_compress(const upx_bytep src, unsigned src_len, upx_bytep dst, unsigned *dst_len,
+                          upx_callback_t *cb, int method, int level,
+                          const ucl_compress_config_t *cconf, ucl_uint *res) {
+    assert(M_IS_NRV2B(method) || M_IS_NRV2E(method));
+    assert(cconf->bb_size == 8 || cconf->bb_size == 16 || cconf->bb_size == 32);
+    unsigned max_offset = cconf->max_offset;
+    if (max_offset == 0 || max_offset > MAX_WINDOW)
+        max_offset = MAX_WINDOW;
+    unsigned max_match = cconf->max_match;
+    if (max_match == 0)
+        max_match = UINT_MAX;
+    if (max_match < MIN_MATCH)
+        return UPX_E_INVALID_ARGUMENT;
+    if M_IS_NRV2E (method)
+        return fast_compress<true>(src, src_len, dst, dst_len, cb, level, cconf->bb_size,
+                                   max_offset, max_match, res);
+    return fast_compress<false>(src, src_len, dst, dst_len, cb, level, cconf->bb_size, max_offset,
+                                max_match, res);
+}
+
+/*************************************************************************
+// doctest checks
+**************************************************************************/
+
+#if !defined(DOCTEST_CONFIG_DISABLE)
+
+// round-trip through the UCL reference decoders; small enough for every start-up
+static bool check_fast_8(const int method, const int level, const byte *u_buf, unsigned u_len) {
+    MemBuffer c_buf, d_buf;
+    c_buf.allocForCompression(u_len);
+    d_buf.allocForDecompression(u_len);
+    ucl_compress_config_t cconf;
+    cconf.reset();
+    cconf.bb_size = 8;
+    ucl_uint result[16];
+    memset(result, 0, sizeof(result));
+    unsigned c_len = c_buf.getSize();
+    int r = upx_ucl_fast_compress(u_buf, u_len, c_buf, &c_len, nullptr, method, level, &cconf,
+                                  result);
+    if (r != UPX_E_OK)
+        return false;
+    ucl_uint d_len = d_buf.getSize();
+    if (method == M_NRV2B_8)
+        r = ucl_nrv2b_decompress_safe_8(c_buf, c_len, d_buf, &d_len, nullptr);
+    else
+        r = ucl_nrv2e_decompress_safe_8(c_buf, c_len, d_buf, &d_len, nullptr);
+    return r == UCL_E_OK && d_len == u_len && memcmp(u_buf, d_buf, u_len) == 0;
+}
+
+TEST_CASE("upx_ucl_fast_compress ucl_decompress_safe_8") {
+    const unsigned u_len = 8192;
+    MemBuffer u_buf(u_len);
+    upx_uint32_t x = 1;
+    const auto fill_random = [&](unsigned from, unsigned to) noexcept {
+        for (unsigned i = from; i < to; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            u_buf[i] = (byte) x;
+        }
+    };
+    const auto check_all = [&](unsigned len) {
+        for (int method : {M_NRV2B_8, M_NRV2E_8})
+            for (int level = 1; level <= 2; level++)
+                CHECK(check_fast_8(method, level, u_buf, len));
+    };
+
+    // incompressible input
+    fill_random(0, u_len);
+    check_all(u_len);
+    // long runs, longer than any match length bucket
+    memset(u_buf + 1000, 'a', 5000);
+    check_all(u_len);
+    // short and long copies just below and past the far offset thresholds
+    // 0x500 (NRV2E) and 0xd00 (NRV2B), where the sent length drops by one
+    for (unsigned off : {0x500u, 0x501u, 0xd00u, 0xd01u}) {
+        fill_random(0, u_len);
+        unsigned pos = off;
+        unsigned k = 0;
+        for (unsigned len : {3u, 3u, 4u, 5u, 6u, 2u, 3u, 17u, 300u, 4u}) {
+            // every other copy is a near one, so the far offset is sent again
+            const unsigned d = (k++ & 1) ? 8 : off;
+            for (unsigned i = 0; i < len; i++, pos++)
+                u_buf[pos] = u_buf[pos - d];
+            pos += 1; // a random literal
+        }
+        check_all(pos);
+    }
+}
+
+#endif // DOCTEST_CONFIG_DISABLE
+
+#if DEBUG && !defined(DOCTEST_CONFIG_DISABLE) && 1
+
+static bool check_fast(const int method, const int level, const byte *u_buf, unsigned u_len,
+                       MemBuffer &c_buf, unsigned &c_len) {
+    MemBuffer d_buf;
+    upx_compress_result_t cresult;
+    c_buf.allocForCompression(u_len);
+    d_buf.allocForDecompression(u_len);
+    c_len = c_buf.getSize();
+    int r = upx_ucl_compress(u_buf, u_len, raw_bytes(c_buf, c_len), &c_len, nullptr, method, level,
+                             NULL_cconf, &cresult);
+    if (r != 0)
+        return false;
+    unsigned d_len = d_buf.getSize();
+    r = upx_ucl_decompress(raw_bytes(c_buf, c_len), c_len, raw_bytes(d_buf, d_len), &d_len, method,
+                           nullptr);
+    return r == 0 && d_len == u_len && memcmp(u_buf, d_buf, u_len) == 0;
+}
+
+static bool check_fast(const int method, const int level, const byte *u_buf, unsigned u_len) {
+    MemBuffer c_buf;
+    unsigned c_len;
+    return check_fast(method, level, u_buf, u_len, c_buf, c_len);
+}
+
+TEST_CASE("upx_ucl_fast_compress") {
+    const unsigned u_len = 65536;
+    MemBuffer u_buf(u_len);
+    // some text-like runs, repeats at near and far offsets, and noise
+    upx_uint32_t x = 1;
+    for (unsigned i = 0; i < u_len; i++) {
+        x = x * 1103515245 + 12345;
+        byte b = (byte) (x >> 24);
+        if ((i & 0x3fff) < 0x1000)
+            b = (byte) ('a' + (i % 7));
+        else if ((i & 0x3fff) < 0x3000 && i >= 0x1400 && (x & 0x300) != 0)
+            b = u_buf[i - ((i & 0x200) ? 3 : 0x1400)];
+        u_buf[i] = b;
+    }
+    static const int methods[] = {M_NRV2B_8, M_NRV2B_LE16, M_NRV2B_LE32,
+                                  M_NRV2E_8, M_NRV2E_LE16, M_NRV2E_LE32};
+    for (int method : methods) {
+        for (int level = 1; level <= 2; level++) {
+            CHECK(check_fast(method, level, u_buf, u_len));
+            CHECK(check_fast(method, level, u_buf, 1));
+            CHECK(check_fast(method, level, u_buf + 100, 5000));
+        }
+    }
+}
+
+TEST_CASE("upx_ucl_fast_compress random data") {
+    // incompressible input must fit into the buffer that Packer::compress() uses
+    const unsigned u_len = 256 * 1024 + 1000;
+    MemBuffer u_buf(u_len);
+    upx_uint32_t x = 1;
+    for (unsigned i = 0; i < u_len; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        u_buf[i] = (byte) x;
+    }
+    for (int method : {M_NRV2B_LE32, M_NRV2B_8, M_NRV2E_LE32, M_NRV2E_LE16}) {
+        for (int level = 1; level <= 2; level++) {
+            MemBuffer c_buf;
+            unsigned c_len = 0;
+            CHECK(check_fast(method, level, u_buf, u_len, c_buf, c_len));
+            CHECK(c_len <= u_len + u_len / 8 + 16);
+        }
+    }
+}
+
+#endif // DEBUG
+
+#endif // WITH_UCL
+
+/* vim:set ts=4 sw=4 et: */
@@ -782,6 +782,7 @@ struct upx_compress_result_t final {
 class ElfLinker;
 typedef ElfLinker Linker; // shortcut
 class Throwable;
+struct Options;
 
 // check/dt_check.cpp
 noinline void upx_compiler_sanity_check() noexcept;
@@ -799,6 +800,7 @@ bool main_set_exit_code(int ec);
 int main_get_options(int argc, char **argv);
 void main_get_envoptions();
 int upx_main(int argc, char *argv[]) may_throw;
+int upx_main_serve_job(int argc, char *argv[]) noexcept;
 
 // msg.cpp
 void printSetNl(int need_nl) noexcept;
@@ -818,6 +820,10 @@ void infoWriting(const char *what, upx_int64_t size);
 void do_one_file(const char *iname, char *oname) may_throw;
 int do_files(int i, int argc, char *argv[]) may_throw;
 
+// serve.cpp
+int upx_serve(const char *path);
+int upx_connect(const char *path, int argc, char **argv);
+
 // help.cpp
 extern const char gitrev[];
 void show_header();
@@ -27,6 +27,13 @@
 
 #include "conf.h"
 #include "file.h"
+#include "util/membuffer.h"
+#if HAVE_MMAP && HAVE_MUNMAP && HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#define WITH_FILE_MMAP 1
+#else
+#define WITH_FILE_MMAP 0
+#endif
 
 /*************************************************************************
 // static file-related util functions; will throw on error
@@ -108,7 +115,8 @@ bool FileBase::do_sopen() {
 
 bool FileBase::close_noexcept() noexcept {
     bool ok = true;
-    if (isOpen() && _fd != STDIN_FILENO && _fd != STDOUT_FILENO && _fd != STDERR_FILENO)
+    if (isOpen() && _fd != STDIN_FILENO && _fd != STDOUT_FILENO && _fd != STDERR_FILENO &&
+        _fd != MEMORY_FD)
         if (::close(_fd) == -1)
             ok = false;
     _fd = -1;
@@ -168,6 +176,55 @@ upx_off_t FileBase::st_size() const { return _length; }
 // InputFile
 **************************************************************************/
 
+InputFile::~InputFile() may_throw {
+    unmap();
+    ::free(mem);
+    mem = nullptr;
+}
+
+bool InputFile::close_noexcept() noexcept {
+    unmap();
+    map_failed = false;
+    ::free(mem);
+    mem = nullptr;
+    mem_len = mem_pos = 0;
+    return super::close_noexcept();
+}
+
+void InputFile::unmap() noexcept {
+#if WITH_FILE_MMAP
+    if (map_ptr != nullptr)
+        (void) ::munmap(map_ptr, map_len);
+#endif
+    map_ptr = nullptr;
+    map_len = 0;
+}
+
+const byte *InputFile::view(upx_off_t off, upx_off_t len) {
+    if (!isOpen() || off < 0 || len < 0 || off + len > _length)
+        throwIOException("bad view");
+    const upx_off_t pos = _offset + off;
+    if (mem != nullptr)
+        return pos + len <= mem_len ? mem + pos : nullptr;
+#if WITH_FILE_MMAP
+    // map the whole file once; the pages come straight from the page cache
+    if (map_ptr == nullptr && !map_failed) {
+        const upx_off_t size = _length_orig;
+        if (size > 0 && mem_size_valid_bytes(size) && S_ISREG(st.st_mode)) {
+            void *p = ::mmap(nullptr, (size_t) size, PROT_READ, MAP_PRIVATE, _fd, 0);
+            if (p != MAP_FAILED) {
+                map_ptr = p;
+                map_len = (size_t) size;
+            }
+        }
+        map_failed = map_ptr == nullptr;
+    }
+    if (map_ptr != nullptr && (upx_uint64_t) (pos + len) <= map_len)
+        return (const byte *) map_ptr + pos;
+#endif
+    return nullptr;
+}
+
 void InputFile::sopen(const char *name, int flags, int shflags) {
     closex();
     _name = name;
@@ -187,10 +244,76 @@ void InputFile::sopen(const char *name, int flags, int shflags) {
     _length_orig = _length;
 }
 
+bool InputFile::openStdin(bool force) {
+    closex();
+    int fd = STDIN_FILENO;
+    if (!force && acc_isatty(fd))
+        return false;
+    if (acc_set_binmode(fd, 1) == -1)
+        throwIOException("<stdin>", errno);
+    upx_uint64_t capacity = 0;
+    for (;;) {
+        if ((upx_uint64_t) mem_len == capacity) {
+            capacity = mem_size(1, capacity ? 2 * capacity : 1024 * 1024); // sanity check
+            void *p = ::realloc(mem, (size_t) capacity);
+            if (p == nullptr)
+                throwOutOfMemoryException();
+            mem = (byte *) p;
+        }
+        errno = 0;
+        long l = acc_safe_hread(fd, mem + mem_len, (long) (capacity - mem_len));
+        if (errno)
+            throwIOException("read error", errno);
+        if (l <= 0)
+            break;
+        mem_len += l;
+    }
+    initMemory("<stdin>", fd);
+    return true;
+}
+
+void InputFile::openMemory(const char *name, const byte *buf, size_t blen) {
+    closex();
+    mem_len = mem_size(1, blen); // sanity check
+    mem = (byte *) ::malloc(blen ? blen : 1);
+    if (mem == nullptr)
+        throwOutOfMemoryException();
+    if (blen != 0)
+        memcpy(mem, buf, blen);
+    initMemory(name, MEMORY_FD);
+}
+
+void InputFile::initMemory(const char *name, int fd) {
+    _name = name;
+    _flags = 0;
+    _shflags = -1;
+    _mode = 0;
+    _offset = 0;
+    // fake a regular file: packers look at st_mode and st_size
+    st = {};
+    if (fd != MEMORY_FD)
+        (void) ::fstat(fd, &st);
+    else
+        st.st_mtime = st.st_atime = time(nullptr);
+    st.st_mode = S_IFREG | 0755;
+    st.st_size = mem_len;
+    _fd = fd;
+    _length = _length_orig = mem_len;
+    mem_pos = 0;
+}
+
 int InputFile::read(SPAN_P(void) buf, upx_int64_t blen) {
     if (!isOpen() || blen < 0)
         throwIOException("bad read");
     int len = (int) mem_size(1, blen); // sanity check
+    if (mem != nullptr) {
+        upx_off_t l = mem_pos < mem_len ? mem_len - mem_pos : 0;
+        if (l > len)
+            l = len;
+        memcpy(raw_bytes(buf, len), mem + mem_pos, (size_t) l);
+        mem_pos += l;
+        return (int) l;
+    }
     errno = 0;
     long l = acc_safe_hread(_fd, raw_bytes(buf, len), len);
     if (errno)
@@ -206,17 +329,51 @@ int InputFile::readx(SPAN_P(void) buf, upx_int64_t blen) {
 }
 
 upx_off_t InputFile::seek(upx_off_t off, int whence) {
-    upx_off_t pos = super::seek(off, whence);
+    upx_off_t pos;
+    if (mem != nullptr) {
+        // same checks as FileBase::seek()
+        if (!isOpen())
+            throwIOException("bad seek 1");
+        mem_size_assert(1, off >= 0 ? off : -off); // sanity check
+        if (whence == SEEK_SET) {
+            if (off < 0)
+                throwIOException("bad seek 2");
+            off += _offset;
+        } else if (whence == SEEK_END) {
+            if (off > 0)
+                throwIOException("bad seek 3");
+            off += _offset + _length;
+        } else if (whence == SEEK_CUR) {
+            off += mem_pos;
+        } else
+            throwInternalError("bad seek: whence");
+        if (off < 0)
+            throwIOException("seek error", EINVAL);
+        mem_pos = off;
+        pos = off - _offset;
+    } else
+        pos = super::seek(off, whence);
     if (_length < pos)
         throwIOException("bad seek 4");
     return pos;
 }
 
+upx_off_t InputFile::tell() const {
+    if (mem != nullptr) {
+        if (!isOpen())
+            throwIOException("bad tell");
+        return mem_pos - _offset;
+    }
+    return super::tell();
+}
+
 upx_off_t InputFile::st_size_orig() const { return _length_orig; }
 
 int InputFile::dupFd() may_throw {
     if (!isOpen())
         throwIOException("bad dup");
+    if (mem != nullptr)
+        throwIOException("dup: not supported for stdin");
 #if defined(HAVE_DUP) && (HAVE_DUP + 0 == 0)
     errno = ENOSYS;
     int r = -1;
@@ -232,6 +389,39 @@ int InputFile::dupFd() may_throw {
 // OutputFile
 **************************************************************************/
 
+OutputFile::~OutputFile() may_throw {
+    if (std::uncaught_exceptions() == 0)
+        closex(); // may_throw
+    else
+        close_noexcept(); // currently in exception unwinding, use noexcept variant
+    ::free(wb);
+}
+
+bool OutputFile::close_noexcept() noexcept {
+    if (spool) { // give back the memory
+        ::free(wb);
+        wb = nullptr;
+        wb_capacity = 0;
+        spool = false;
+    }
+    wb_start = -1;
+    wb_len = wb_pos = 0;
+    return super::close_noexcept();
+}
+
+void OutputFile::closex() may_throw {
+    if (isOpen() && spool && wb_len != 0 && _fd != MEMORY_FD) {
+        errno = 0;
+        long l = acc_safe_hwrite(_fd, wb, wb_len);
+        if (l != (long) wb_len)
+            throwIOException("write error", errno);
+        wb_len = wb_pos = 0;
+    }
+    if (isOpen())
+        flush();
+    super::closex();
+}
+
 void OutputFile::sopen(const char *name, int flags, int shflags, int mode) {
     closex();
     _name = name;
@@ -268,9 +458,35 @@ bool OutputFile::openStdout(int flags, bool force) {
     if (flags && acc_set_binmode(fd, 1) == -1)
         throwIOException(_name, errno);
     _fd = fd;
+    // stdout is usually a pipe, so keep everything until closex()
+    spool = true;
+    wb_start = 0;
+    wb_len = wb_pos = 0;
     return true;
 }
 
+void OutputFile::openMemory(const char *name) {
+    closex();
+    _name = name;
+    _flags = 0;
+    _shflags = -1;
+    _mode = 0;
+    _offset = 0;
+    _length = 0;
+    _fd = MEMORY_FD;
+    spool = true;
+    wb_start = 0;
+    wb_len = wb_pos = 0;
+}
+
+unsigned OutputFile::getMemory(MemBuffer &mb) const {
+    assert(spool && _fd == MEMORY_FD);
+    mb.alloc(upx::umax(wb_len, 1u));
+    if (wb_len != 0)
+        memcpy(mb, wb, wb_len);
+    return wb_len;
+}
+
 void OutputFile::write(SPAN_0(const void) buf, upx_int64_t blen) {
     if (!isOpen() || blen < 0)
         throwIOException("bad write");
@@ -278,14 +494,40 @@ void OutputFile::write(SPAN_0(const void) buf, upx_int64_t blen) {
     if (blen == 0)
         return;
     int len = (int) mem_size(1, blen); // sanity check
-    errno = 0;
 #if WITH_XSPAN >= 2
     NO_fprintf(stderr, "write %p %zd (%p) %d\n", buf.raw_ptr(), buf.raw_size_in_bytes(),
                buf.raw_base(), len);
 #endif
-    long l = acc_safe_hwrite(_fd, raw_bytes(buf, len), len);
-    if (l != len)
-        throwIOException("write error", errno);
+    if (spool) {
+        spool_reserve((upx_uint64_t) wb_pos + len);
+        memcpy(wb + wb_pos, raw_bytes(buf, len), len);
+        wb_pos += len;
+        wb_len = upx::umax(wb_len, wb_pos);
+    } else if ((unsigned) len < WB_SIZE) {
+        if (wb_len != 0 && wb_pos + len > WB_SIZE)
+            flush();
+        if (wb_len == 0) {
+            if (wb == nullptr) {
+                wb = (byte *) ::malloc(WB_SIZE);
+                assert(wb != nullptr);
+                wb_capacity = WB_SIZE;
+            }
+            if (wb_start < 0)
+                wb_start = ::lseek(_fd, 0, SEEK_CUR); // -1 for a pipe
+            wb_pos = 0;
+        }
+        memcpy(wb + wb_pos, raw_bytes(buf, len), len);
+        wb_pos += len;
+        wb_len = upx::umax(wb_len, wb_pos);
+    } else {
+        flush();
+        errno = 0;
+        long l = acc_safe_hwrite(_fd, raw_bytes(buf, len), len);
+        if (l != len)
+            throwIOException("write error", errno);
+        if (wb_start >= 0)
+            wb_start += len;
+    }
     bytes_written += len;
 #if TESTING && 0
     static upx_std_atomic(bool) dumping;
@@ -300,7 +542,51 @@ void OutputFile::write(SPAN_0(const void) buf, upx_int64_t blen) {
 #endif
 }
 
+void OutputFile::spool_reserve(upx_uint64_t bytes) {
+    if (bytes <= wb_capacity)
+        return;
+    upx_uint64_t new_capacity = wb_capacity + (wb_capacity >> 1) + WB_SIZE;
+    new_capacity = upx::umax(bytes, new_capacity);
+    (void) mem_size(1, new_capacity); // sanity check
+    void *p = ::realloc(wb, (size_t) new_capacity);
+    if (p == nullptr)
+        throwOutOfMemoryException();
+    wb = (byte *) p;
+    wb_capacity = (unsigned) new_capacity;
+}
+
+void OutputFile::flush() {
+    if (wb_len == 0 || spool) // spool: see closex()
+        return;
+    const unsigned len = wb_len;
+    const unsigned pos = wb_pos;
+    wb_len = wb_pos = 0;
+    errno = 0;
+    long l = acc_safe_hwrite(_fd, wb, len);
+    if (l != (long) len)
+        throwIOException("write error", errno);
+    if (pos != len) { // seek() moved back into the buffer
+        assert(wb_start >= 0);
+        if (::lseek(_fd, wb_start + pos, SEEK_SET) < 0)
+            throwIOException("seek error", errno);
+    }
+    if (wb_start >= 0)
+        wb_start += pos;
+}
+
+upx_off_t OutputFile::tell() const {
+    if (spool)
+        return wb_pos - _offset;
+    if (wb_len == 0)
+        return super::tell();
+    if (wb_start >= 0)
+        return wb_start + wb_pos - _offset;
+    return super::tell() + wb_pos;
+}
+
 upx_off_t OutputFile::st_size() const {
+    if (spool)
+        return wb_len;
     if (opt->to_stdout) {     // might be a pipe ==> .st_size is invalid
         return bytes_written; // too big if seek()+write() instead of rewrite()
     }
@@ -308,18 +594,20 @@ upx_off_t OutputFile::st_size() const {
     my_st.st_size = 0;
     if (::fstat(_fd, &my_st) != 0)
         throwIOException(_name, errno);
+    if (wb_len != 0 && wb_start >= 0 && my_st.st_size < wb_start + wb_len)
+        return wb_start + wb_len; // pending writes extend the file
     return my_st.st_size;
 }
 
 void OutputFile::rewrite(SPAN_P(const void) buf, int len) {
-    assert(!opt->to_stdout);
+    assert(spool || !opt->to_stdout);
     write(buf, len);
     bytes_written -= len; // restore
 }
 
 upx_off_t OutputFile::seek(upx_off_t off, int whence) {
     mem_size_assert(1, off >= 0 ? off : -off); // sanity check
-    assert(!opt->to_stdout);
+    assert(spool || !opt->to_stdout);
     switch (whence) {
     case SEEK_SET: {
         if (bytes_written < off) {
@@ -331,7 +619,44 @@ upx_off_t OutputFile::seek(upx_off_t off, int whence) {
         _length = bytes_written; // necessary
     } break;
     }
-    return super::seek(off, whence);
+    if (spool) {
+        upx_off_t pos = -1;
+        if (whence == SEEK_SET)
+            pos = _offset + off;
+        else if (whence == SEEK_END)
+            pos = _offset + _length + off;
+        else if (whence == SEEK_CUR)
+            pos = wb_pos + off;
+        else
+            throwInternalError("bad seek: whence");
+        if (pos < 0)
+            throwIOException("seek error", EINVAL);
+        if (pos > wb_len) { // like a hole in a file
+            spool_reserve(pos);
+            memset(wb + wb_len, 0, (size_t) (pos - wb_len));
+            wb_len = (unsigned) pos;
+        }
+        wb_pos = (unsigned) pos;
+        return pos - _offset;
+    }
+    if (wb_len != 0 && wb_start >= 0) {
+        // stay inside the write-back buffer if possible
+        upx_off_t pos = -1;
+        if (whence == SEEK_SET && off >= 0)
+            pos = _offset + off;
+        else if (whence == SEEK_END && off <= 0)
+            pos = _offset + _length + off;
+        else if (whence == SEEK_CUR)
+            pos = wb_start + wb_pos + off;
+        if (pos >= wb_start && pos <= wb_start + wb_len) {
+            wb_pos = (unsigned) (pos - wb_start);
+            return pos - _offset;
+        }
+    }
+    flush();
+    upx_off_t l = super::seek(off, whence);
+    wb_start = _offset + l;
+    return l;
 }
 
 // WARNING: fsync() does not exist in some Windows environments.
@@ -346,20 +671,28 @@ upx_off_t OutputFile::seek(upx_off_t off, int whence) {
 //}
 
 void OutputFile::set_extent(upx_off_t offset, upx_off_t length) {
+    flush();
     super::set_extent(offset, length);
     bytes_written = 0;
     if (0 == offset && 0xffffffffLL == length) { // TODO: check all callers of this method
         st.st_size = 0;
-        if (::fstat(_fd, &st) != 0)
+        if (spool)
+            st.st_size = wb_len;
+        else if (::fstat(_fd, &st) != 0)
             throwIOException(_name, errno);
         _length = st.st_size - offset;
     }
 }
 
 upx_off_t OutputFile::unset_extent() {
-    upx_off_t l = ::lseek(_fd, 0, SEEK_END);
+    flush();
+    upx_off_t l = spool ? (upx_off_t) wb_len : ::lseek(_fd, 0, SEEK_END);
     if (l < 0)
         throwIOException("lseek error", errno);
+    if (spool)
+        wb_pos = wb_len;
+    else
+        wb_start = l;
     _offset = 0;
     _length = l;
     bytes_written = _length;
@@ -391,4 +724,192 @@ TEST_CASE("file") {
     CHECK(fo.getBytesWritten() == 0);
 }
 
+TEST_CASE("file in memory") {
+    byte buf[64];
+    for (unsigned i = 0; i < 64; i++)
+        buf[i] = (byte) i;
+    InputFile fi;
+    fi.openMemory("<memory>", buf, sizeof(buf));
+    CHECK(fi.isOpen());
+    CHECK(fi.st_size() == 64);
+    CHECK(S_ISREG(fi.st.st_mode));
+    byte tmp[16];
+    fi.seek(60, SEEK_SET);
+    CHECK(fi.read(tmp, 16) == 4);
+    CHECK((tmp[0] == 60 && tmp[3] == 63));
+    CHECK(fi.tell() == 64);
+    CHECK(fi.view(60, 4) != nullptr);
+    CHECK(fi.view(60, 4)[3] == 63);
+    CHECK_THROWS(fi.view(60, 8));
+    CHECK_THROWS(fi.dupFd());
+    fi.closex();
+    CHECK(!fi.isOpen());
+
+    OutputFile fo;
+    fo.openMemory("<memory>");
+    CHECK(fo.isOpen());
+    fo.write(buf, 32);
+    fo.seek(8, SEEK_SET);
+    fo.rewrite(buf + 32, 4);
+    fo.seek(0, SEEK_END);
+    fo.write(buf + 32, 32);
+    CHECK(fo.st_size() == 64);
+    MemBuffer mb;
+    CHECK(fo.getMemory(mb) == 64);
+    CHECK((mb[0] == 0 && mb[8] == 32 && mb[11] == 35 && mb[12] == 12 && mb[63] == 63));
+    fo.closex();
+    CHECK(!fo.isOpen());
+}
+
+#if DEBUG && (ACC_OS_POSIX)
+// write-back buffer of OutputFile on a real file; uses FileBase::tell()
+// to check that the override is used
+TEST_CASE("OutputFile write-back buffer") {
+    char name[] = "/tmp/upx-doctest-XXXXXX";
+    int fd = ::mkstemp(name);
+    if (fd < 0)
+        return;
+    (void) ::close(fd);
+    byte buf[256];
+    for (unsigned i = 0; i < 256; i++)
+        buf[i] = (byte) i;
+    byte tmp[256];
+    InputFile fi;
+    OutputFile fo;
+    FileBase &fb = fo;
+
+    // seek into the buffered range, rewrite, then continue at the end
+    fo.open(name, O_WRONLY | O_TRUNC | O_BINARY, 0600);
+    fo.write(buf, 100);
+    CHECK(fb.tell() == 100);
+    CHECK(fo.seek(10, SEEK_SET) == 10);
+    fo.rewrite(buf + 200, 4);
+    CHECK(fb.tell() == 14);
+    fo.seek(0, SEEK_END);
+    CHECK(fb.tell() == 100);
+    fo.write(buf + 100, 20);
+    CHECK(fo.getBytesWritten() == 120);
+    fo.closex();
+    fi.open(name, O_RDONLY | O_BINARY);
+    CHECK(fi.st_size() == 120);
+    fi.readx(tmp, 120);
+    fi.closex();
+    CHECK((tmp[9] == 9 && tmp[10] == 200 && tmp[13] == 203 && tmp[14] == 14));
+    CHECK((tmp[99] == 99 && tmp[100] == 100 && tmp[119] == 119));
+
+    // seek past the buffered range: flush, then a real lseek leaving a hole
+    fo.open(name, O_WRONLY | O_TRUNC | O_BINARY, 0600);
+    fo.write(buf, 100);
+    CHECK(fo.seek(200, SEEK_SET) == 200);
+    CHECK(fb.tell() == 200);
+    fo.write(buf + 50, 10);
+    CHECK(fb.tell() == 210);
+    CHECK(fo.st_size() == 210);
+    fo.closex();
+    fi.open(name, O_RDONLY | O_BINARY);
+    CHECK(fi.st_size() == 210);
+    fi.readx(tmp, 210);
+    fi.closex();
+    CHECK((tmp[99] == 99 && tmp[100] == 0 && tmp[199] == 0 && tmp[200] == 50 && tmp[209] == 59));
+
+    // flush() with wb_pos != wb_len must leave the file position at wb_pos
+    fo.open(name, O_WRONLY | O_TRUNC | O_BINARY, 0600);
+    fo.write(buf, 100);
+    fo.seek(50, SEEK_SET);
+    fo.flush();
+    CHECK(fb.tell() == 50);
+    fo.rewrite(buf + 150, 4);
+    CHECK(fb.tell() == 54);
+    fo.closex();
+    fi.open(name, O_RDONLY | O_BINARY);
+    CHECK(fi.st_size() == 100);
+    fi.readx(tmp, 100);
+    fi.closex();
+    CHECK((tmp[49] == 49 && tmp[50] == 150 && tmp[53] == 153 && tmp[54] == 54 && tmp[99] == 99));
+
+    // closex() right after a rewrite() at the start of the buffer
+    fo.open(name, O_WRONLY | O_TRUNC | O_BINARY, 0600);
+    fo.write(buf, 100);
+    fo.seek(0, SEEK_SET);
+    fo.rewrite(buf + 250, 4);
+    fo.closex();
+    fi.open(name, O_RDONLY | O_BINARY);
+    CHECK(fi.st_size() == 100);
+    fi.readx(tmp, 100);
+    fi.closex();
+    CHECK((tmp[0] == 250 && tmp[3] == 253 && tmp[4] == 4 && tmp[99] == 99));
+
+    (void) FileBase::unlink_noexcept(name);
+}
+#endif
+
+#if DEBUG && (ACC_OS_POSIX)
+// InputFile::openStdin() and the spool mode of OutputFile::openStdout(),
+// with pipes temporarily installed as stdin and stdout
+TEST_CASE("file from stdin to stdout") {
+    byte buf[4096];
+    for (unsigned i = 0; i < sizeof(buf); i++)
+        buf[i] = (byte) (i * 7);
+    int in_pipe[2], out_pipe[2];
+    if (::pipe(in_pipe) != 0)
+        return;
+    if (::pipe(out_pipe) != 0) {
+        (void) ::close(in_pipe[0]);
+        (void) ::close(in_pipe[1]);
+        return;
+    }
+    CHECK(::write(in_pipe[1], buf, sizeof(buf)) == (long) sizeof(buf));
+    (void) ::close(in_pipe[1]);
+    fflush(stdout);
+    {
+        // restores stdin and stdout even if a check throws
+        struct Redirect final {
+            int fd, saved;
+            Redirect(int new_fd, int fd_) noexcept : fd(fd_), saved(::dup(fd_)) {
+                (void) ::dup2(new_fd, fd);
+                (void) ::close(new_fd);
+            }
+            ~Redirect() noexcept {
+                (void) ::dup2(saved, fd);
+                (void) ::close(saved);
+            }
+        };
+        Redirect redirect_stdin(in_pipe[0], STDIN_FILENO);
+        Redirect redirect_stdout(out_pipe[1], STDOUT_FILENO);
+
+        byte tmp[sizeof(buf)];
+        InputFile fi;
+        CHECK(fi.openStdin(true));
+        CHECK(S_ISREG(fi.st.st_mode));
+        CHECK(fi.st_size() == (upx_off_t) sizeof(buf));
+        fi.seek(100, SEEK_SET);
+        fi.readx(tmp, 4);
+        CHECK((tmp[0] == buf[100] && tmp[3] == buf[103]));
+        fi.seek(0, SEEK_SET);
+        fi.readx(tmp, sizeof(buf));
+        CHECK(memcmp(tmp, buf, sizeof(buf)) == 0);
+        fi.closex();
+
+        // spool: nothing reaches stdout before closex(), so seek()+rewrite() works
+        OutputFile fo;
+        CHECK(fo.openStdout(1, true));
+        fo.write(tmp, sizeof(buf));
+        fo.seek(16, SEEK_SET);
+        fo.rewrite(buf + 1000, 8);
+        CHECK(fo.tell() == 24);
+        fo.seek(0, SEEK_END);
+        fo.write(buf, 16);
+        CHECK(fo.st_size() == (upx_off_t) sizeof(buf) + 16);
+        fo.closex();
+    }
+    byte out[sizeof(buf) + 16];
+    long l = acc_safe_hread(out_pipe[0], out, sizeof(out));
+    (void) ::close(out_pipe[0]);
+    CHECK(l == (long) sizeof(out));
+    CHECK((memcmp(out, buf, 16) == 0 && memcmp(out + 16, buf + 1000, 8) == 0));
+    CHECK(memcmp(out + 24, buf + 24, sizeof(buf) - 24) == 0);
+    CHECK(memcmp(out + sizeof(buf), buf, 16) == 0);
+}
+#endif
+
 /* vim:set ts=4 sw=4 et: */
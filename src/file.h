@@ -37,14 +37,16 @@ protected:
     virtual ~FileBase() may_throw;
 
 public:
-    bool close_noexcept() noexcept;
-    void closex() may_throw;
+    virtual bool close_noexcept() noexcept;
+    virtual void closex() may_throw;
     bool isOpen() const noexcept { return _fd >= 0; }
+    // pseudo file descriptor of in-memory files; see openMemory()
+    static constexpr int MEMORY_FD = 0x7fffffff;
     int getFd() const noexcept { return _fd; }
     const char *getName() const noexcept { return _name; }
 
     virtual upx_off_t seek(upx_off_t off, int whence);
-    upx_off_t tell() const;
+    virtual upx_off_t tell() const;
     virtual upx_off_t st_size() const; // { return _length; }
     virtual void set_extent(upx_off_t offset, upx_off_t length);
 
@@ -78,20 +80,44 @@ class InputFile final : public FileBase {
 
 public:
     explicit InputFile() noexcept = default;
+    virtual ~InputFile() may_throw;
 
     void sopen(const char *name, int flags, int shflags);
     void open(const char *name, int flags) { sopen(name, flags, -1); }
+    // read all of stdin into memory; a pipe cannot seek
+    bool openStdin(bool force = false);
+    // use a private copy of buf as file contents
+    void openMemory(const char *name, const byte *buf, size_t blen);
+    virtual bool close_noexcept() noexcept override;
 
     int read(SPAN_P(void) buf, upx_int64_t blen);
     int readx(SPAN_P(void) buf, upx_int64_t blen);
 
     virtual upx_off_t seek(upx_off_t off, int whence) override;
+    virtual upx_off_t tell() const override;
     upx_off_t st_size_orig() const;
 
     noinline int dupFd() may_throw;
 
+    // read-only view of len bytes at off (relative to the current extent)
+    // without copying, or nullptr if not available; valid until closex()
+    const byte *view(upx_off_t off, upx_off_t len);
+
 protected:
     upx_off_t _length_orig = 0;
+
+    // in-memory contents if opened by openStdin(); all reads and seeks
+    // are served from here instead of _fd
+    byte *mem = nullptr;
+    upx_off_t mem_len = 0;
+    upx_off_t mem_pos = 0; // like the file position of _fd, i.e. including _offset
+    void initMemory(const char *name, int fd);
+
+    // lazy read-only mapping of the whole file; see view()
+    void *map_ptr = nullptr;
+    size_t map_len = 0;
+    bool map_failed = false;
+    void unmap() noexcept;
 };
 
 /*************************************************************************
@@ -103,15 +129,24 @@ class OutputFile final : public FileBase {
 
 public:
     explicit OutputFile() noexcept = default;
+    virtual ~OutputFile() may_throw;
 
     void sopen(const char *name, int flags, int shflags, int mode);
     void open(const char *name, int flags, int mode) { sopen(name, flags, -1, mode); }
     bool openStdout(int flags = 0, bool force = false);
+    // collect all output in memory; use getMemory() before closing
+    void openMemory(const char *name);
+    unsigned getMemory(MemBuffer &mb) const may_throw; // returns the file size
+    virtual bool close_noexcept() noexcept override; // discards pending writes
+    virtual void closex() may_throw override;
 
     // info: allow nullptr if blen == 0
     void write(SPAN_0(const void) buf, upx_int64_t blen);
+    // write out pending small writes; needed before using getFd() directly
+    void flush() may_throw;
 
     virtual upx_off_t seek(upx_off_t off, int whence) override;
+    virtual upx_off_t tell() const override;
     virtual upx_off_t st_size() const override; // { return _length; }
     virtual void set_extent(upx_off_t offset, upx_off_t length) override;
     upx_off_t unset_extent(); // returns actual length
@@ -126,6 +161,23 @@ public:
 
 protected:
     upx_off_t bytes_written = 0;
+
+    // Write-back buffer: small writes are collected in wb[] and written
+    // with a single system call. A seek() which stays inside the buffered
+    // range only moves wb_pos, so patching headers with seek()+rewrite()
+    // does not force a flush. While wb_len != 0 the file position of _fd
+    // is wb_start.
+    static constexpr unsigned WB_SIZE = 64 * 1024;
+    byte *wb = nullptr;
+    upx_off_t wb_start = -1; // file position of wb[0]; -1 if unknown (e.g. a pipe)
+    unsigned wb_len = 0;     // valid bytes in wb[]
+    unsigned wb_pos = 0;     // current position in wb[]; wb_pos <= wb_len
+    unsigned wb_capacity = 0;
+    // Spool mode (stdout and memory): wb[] grows to hold the whole file,
+    // which is only written out by closex(). This keeps seek()+rewrite()
+    // working.
+    bool spool = false;
+    void spool_reserve(upx_uint64_t bytes) may_throw;
 };
 
 /* vim:set ts=4 sw=4 et: */
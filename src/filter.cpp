@@ -125,6 +125,13 @@ bool Filter::filter(SPAN_0(byte) xbuf, unsigned buf_len_) {
     if (clevel != 1)
         this->adler = upx_adler32(this->buf, this->buf_len);
 
+    if (undo_log != nullptr) {
+        undo_log->reset();
+        undo_log->buf = this->buf;
+        undo_log->buf_len = this->buf_len;
+        undo_log->id = this->id;
+    }
+
     NO_printf("filter: %02x %p %d\n", this->id, this->buf, this->buf_len);
     // OutputFile::dump("filter.dat", buf, buf_len);
     int r = (*fe->do_filter)(this);
@@ -152,11 +159,20 @@ void Filter::unfilter(SPAN_0(byte) xbuf, unsigned buf_len_, bool verify_checksum
     if (!fe->do_unfilter)
         throwInternalError("unfilter-2");
 
-    NO_printf("unfilter: %02x %p %d\n", this->id, this->buf, this->buf_len);
-    int r = (*fe->do_unfilter)(this);
-    NO_printf("unfilter: %02x %d\n", fe->id, r);
-    if (r != 0)
-        throwInternalError("unfilter-3");
+    // fast path: undo the preceding filter() call
+    if (undo_log != nullptr && undo_log->restore(this)) {
+        NO_printf("unfilter: %02x undo\n", this->id);
+#if !(DEBUG)
+        if (opt->debug.debug_level == 0)
+            verify_checksum = false;
+#endif
+    } else {
+        NO_printf("unfilter: %02x %p %d\n", this->id, this->buf, this->buf_len);
+        int r = (*fe->do_unfilter)(this);
+        NO_printf("unfilter: %02x %d\n", fe->id, r);
+        if (r != 0)
+            throwInternalError("unfilter-3");
+    }
     // OutputFile::dump("unfilter.dat", buf, buf_len);
 
     // verify checksum
@@ -181,6 +197,40 @@ void Filter::verifyUnfilter() {
         unfilter(this->buf, this->buf_len, true);
 }
 
+/*************************************************************************
+// FilterUndoLog
+**************************************************************************/
+
+FilterUndoLog::~FilterUndoLog() noexcept { ::free(entries); }
+
+void FilterUndoLog::reset() noexcept {
+    count = 0;
+    complete = false;
+    buf = nullptr;
+    buf_len = 0;
+    id = -1;
+}
+
+void FilterUndoLog::grow() may_throw {
+    const unsigned new_capacity = capacity + 1024 + (capacity >> 1);
+    void *p = ::realloc(entries, mem_size(sizeof(Entry), new_capacity));
+    if (p == nullptr)
+        throwOutOfMemoryException();
+    entries = (Entry *) p;
+    capacity = new_capacity;
+}
+
+// restore the buffer if this log describes the last f->filter() call
+bool FilterUndoLog::restore(Filter *f) noexcept {
+    const bool ok = complete && f->buf == buf && f->buf_len == buf_len && f->id == id;
+    if (ok) {
+        for (unsigned i = count; i-- > 0;)
+            set_le32(f->buf + entries[i].pos, entries[i].le32);
+    }
+    reset();
+    return ok;
+}
+
 bool Filter::scan(SPAN_0(const byte) xbuf, unsigned buf_len_) {
     const byte *const buf_ = raw_bytes(xbuf, buf_len_);
     // Note: must use const_cast here. This is fine as the scan
@@ -210,4 +260,107 @@ bool Filter::scan(SPAN_0(const byte) xbuf, unsigned buf_len_) {
     return false;
 }
 
+/*************************************************************************
+//
+**************************************************************************/
+
+TEST_CASE("Filter sub8/sub16/sub32") {
+    static const int ids[] = {0x90, 0x91, 0x92, 0x93, 0xa0, 0xa1,
+                              0xa2, 0xa3, 0xb0, 0xb1, 0xb2, 0xb3};
+    static const unsigned lens[] = {99, 100, 131, 1000, 4099}; // min_buf_len is 99
+    byte orig[4099 + 1], buf[4099 + 1], ref[4099 + 1];
+    unsigned r = 0x12345678;
+    for (unsigned i = 0; i < sizeof(orig); i++) {
+        r = r * 1103515245 + 12345;
+        orig[i] = (byte) (r >> 24);
+    }
+    for (int id : ids) {
+        const unsigned size = (id >> 4) == 0x9 ? 1 : (id >> 4) == 0xa ? 2 : 4;
+        const unsigned n = (id & 0xf) + 1;
+        for (unsigned len : lens) {
+            const unsigned elems = len / size;
+            if (elems <= n)
+                continue;
+            // reference: y[k] = x[k] - x[k-N] on little-endian elements
+            memcpy(ref, orig, len);
+            for (unsigned k = n; k < elems; k++) {
+                const byte *x = orig + k * size;
+                const byte *p = orig + (k - n) * size;
+                byte *y = ref + k * size;
+                if (size == 1)
+                    *y = (byte) (*x - *p);
+                else if (size == 2)
+                    set_le16(y, get_le16(x) - get_le16(p));
+                else
+                    set_le32(y, get_le32(x) - get_le32(p));
+            }
+            memcpy(buf, orig, len);
+            Filter ft(10);
+            ft.init(id);
+            CHECK(ft.filter(buf, len));
+            CHECK(ft.calls == elems - n);
+            CHECK(memcmp(buf, ref, len) == 0);
+            ft.unfilter(buf, len, true);
+            CHECK(memcmp(buf, orig, len) == 0);
+        }
+    }
+}
+
+TEST_CASE("Filter cto/ctoj") {
+    static const int ids[] = {0x24, 0x25, 0x26, 0x36};
+    constexpr unsigned len = 64 * 1024 + 3;
+    static byte orig[len], buf[len];
+    unsigned r = 0x12345678;
+    for (unsigned i = 0; i < len; i++) {
+        r = r * 1103515245 + 12345;
+        orig[i] = (byte) ((r >> 24) & 0x7f);
+    }
+    // sprinkle calls and jumps, some inside the buffer and some back-to-back;
+    // the low byte of the outside ones stays below 0x80 to leave a free cto
+    for (unsigned i = 16; i + 5 < len; i += 3 + (i % 29)) {
+        r = r * 1103515245 + 12345;
+        orig[i] = (r & 0x100) ? 0xe8 : 0xe9;
+        if (r & 0x600)
+            set_le32(orig + i + 1, ((r >> 12) % len) - (i + 5));
+        else
+            set_le32(orig + i + 1, 0x40000000 + ((r >> 12) & 0x7f));
+    }
+    for (int id : ids) {
+        memcpy(buf, orig, len);
+        Filter ft(10);
+        ft.init(id, 0x1000);
+        CHECK(ft.filter(buf, len));
+        CHECK(ft.calls > 0);
+        CHECK(memcmp(buf, orig, len) != 0);
+        ft.unfilter(buf, len, true);
+        CHECK(memcmp(buf, orig, len) == 0);
+        // scan must agree with filter
+        Filter fs(10);
+        fs.init(id, 0x1000);
+        CHECK(fs.scan(orig, len));
+        CHECK(fs.calls == ft.calls);
+        CHECK(fs.noncalls == ft.noncalls);
+        // unfilter via the undo log
+        FilterUndoLog undo_log;
+        Filter fu(10);
+        fu.init(id, 0x1000);
+        fu.undo_log = &undo_log;
+        CHECK(fu.filter(buf, len));
+        CHECK(undo_log.complete);
+        fu.unfilter(buf, len, true);
+        CHECK(!undo_log.complete);
+        CHECK(memcmp(buf, orig, len) == 0);
+    }
+    // filters without undo support fall back to the real unfilter
+    FilterUndoLog undo_log;
+    Filter ft(10);
+    ft.init(0x16, 0x1000);
+    ft.undo_log = &undo_log;
+    memcpy(buf, orig, len);
+    CHECK(ft.filter(buf, len));
+    CHECK(!undo_log.complete);
+    ft.unfilter(buf, len, true);
+    CHECK(memcmp(buf, orig, len) == 0);
+}
+
 /* vim:set ts=4 sw=4 et: */
@@ -44,6 +44,8 @@
 // to absolute addresses so that the buffer compresses better.
 **************************************************************************/
 
+class FilterUndoLog;
+
 class Filter final {
 public:
     explicit Filter(int level) noexcept;
@@ -70,6 +72,7 @@ public:
     // Input parameters used by various filters.
     unsigned addvalue;
     const int *preferred_ctos = nullptr;
+    FilterUndoLog *undo_log = nullptr; // optional, see below
 
     // Input/output parameters used by various filters
     byte cto; // call trick offset
@@ -89,6 +92,51 @@ private:
     int clevel; // compression level
 };
 
+/*************************************************************************
+// An optional undo log for the compression search in
+// Packer::compressWithFilters(), where every successful filter() is
+// immediately followed by an unfilter().
+//
+// Filters that support it record the original value of each patched
+// word, and unfilter() then just puts these back instead of running
+// the real unfilter over the whole buffer. The real unfilter still gets
+// exercised by Packer::verifyOverlappingDecompression().
+**************************************************************************/
+
+class FilterUndoLog final : private noncopyable {
+public:
+    explicit FilterUndoLog() noexcept {}
+    ~FilterUndoLog() noexcept;
+
+    void reset() noexcept;
+    forceinline void add(unsigned pos, unsigned le32) may_throw {
+        if very_unlikely (count == capacity)
+            grow();
+        entries[count].pos = pos;
+        entries[count].le32 = le32;
+        count++;
+    }
+    // set by the filter implementation when the log covers all changes
+    bool complete = false;
+
+private:
+    void grow() may_throw;
+    bool restore(Filter *f) noexcept;
+    friend class Filter;
+
+    struct Entry {
+        unsigned pos;
+        unsigned le32;
+    };
+    Entry *entries = nullptr;
+    unsigned count = 0;
+    unsigned capacity = 0;
+    // the filter() call this log belongs to
+    const byte *buf = nullptr;
+    unsigned buf_len = 0;
+    int id = -1;
+};
+
 /*************************************************************************
 // We don't want a full OO interface here because of
 // certain implementation speed reasons.
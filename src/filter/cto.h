@@ -43,6 +43,7 @@ static int F(Filter *f) {
     unsigned ic, jc, kc;
     unsigned calls = 0, noncalls = 0, noncalls2 = 0;
     unsigned lastnoncall = size, lastcall = 0;
+    CtoMarks marks(size);
 
     // find a 16 MiB large empty address space
     {
@@ -57,6 +58,7 @@ static int F(Filter *f) {
         for (ic = 0; ic < size - 5; ic++) {
             if (!COND(b, ic))
                 continue;
+            marks.set(ic);
             jc = get_le32(b + ic + 1) + ic + 1;
             if (jc < size) {
                 if (jc + addvalue >= (1u << 24)) // hi 8 bits won't be cto8
@@ -73,9 +75,8 @@ static int F(Filter *f) {
     const unsigned cto = (unsigned) f->cto << 24;
 #endif
 
-    for (ic = 0; ic < size - 5; ic++) {
-        if (!COND(b, ic))
-            continue;
+    // only revisit the positions where COND() matched in the first pass
+    for (ic = 0; (ic = marks.next(ic, size - 5)) < size - 5; ic++) {
         jc = get_le32(b + ic + 1) + ic + 1;
         // try to detect 'real' calls only
         if (jc < size) {
@@ -100,6 +101,10 @@ static int F(Filter *f) {
                     continue;
                 }
             }
+#ifdef U
+            if (f->undo_log != nullptr)
+                f->undo_log->add(ic + 1, jc - ic - 1); // original rel32
+#endif
             calls++;
             ic += 4;
             lastcall = ic + 1;
@@ -113,6 +118,10 @@ static int F(Filter *f) {
     f->calls = calls;
     f->noncalls = noncalls;
     f->lastcall = lastcall;
+#ifdef U
+    if (f->undo_log != nullptr)
+        f->undo_log->complete = true;
+#endif
 
 #if 0 || defined(TESTING)
     printf("\ncalls=%d noncalls=%d noncalls2=%d text_size=%x calltrickoffset=%x\n",calls,noncalls,noncalls2,size,cto);
@@ -27,6 +27,7 @@
 
 #include "../conf.h"
 #include "../filter.h"
+#include "../util/membuffer.h"
 
 static unsigned umin(const unsigned a, const unsigned b) { return (a <= b) ? a : b; }
 
@@ -61,4 +61,54 @@ static int getcto(Filter *f, const byte *buf, const int n = 256) {
     return ic;
 }
 
+/*************************************************************************
+// CtoMarks - a bitmap of the positions where COND() matched
+//
+// The first pass over the buffer has to look at every byte anyway to find
+// a free cto, so it also records the candidate positions. The second pass
+// (rewrite and statistics) then only visits those instead of testing COND()
+// on every byte again, which matters for multi-MiB code sections.
+// Replaying the marks is exact as long as COND(b, x) only looks at b[x]:
+// the second pass never modifies a byte it visits afterwards.
+**************************************************************************/
+
+class CtoMarks final : private noncopyable {
+public:
+    explicit CtoMarks(unsigned size) : nwords(size / 64 + 1) {
+        mb.alloc(nwords * sizeof(upx_uint64_t));
+        mb.clear();
+        w = (upx_uint64_t *) mb.getVoidPtr();
+    }
+    forceinline void set(unsigned pos) noexcept { w[pos >> 6] |= upx_uint64_t(1) << (pos & 63); }
+    // first marked position >= pos, or end if there is none below end
+    unsigned next(unsigned pos, unsigned end) const noexcept {
+        unsigned i = pos >> 6;
+        if (i >= nwords)
+            return end;
+        upx_uint64_t v = w[i] & (~upx_uint64_t(0) << (pos & 63));
+        while (v == 0) {
+            if (++i >= nwords)
+                return end;
+            v = w[i];
+        }
+        const unsigned r = i * 64 + ctz64(v);
+        return r < end ? r : end;
+    }
+
+private:
+    static forceinline unsigned ctz64(upx_uint64_t v) noexcept {
+#if __has_builtin(__builtin_ctzll)
+        return __builtin_ctzll(v);
+#else
+        unsigned r = 0;
+        for (; !(v & 1); v >>= 1)
+            r++;
+        return r;
+#endif
+    }
+    MemBuffer mb;
+    upx_uint64_t *w = nullptr;
+    const unsigned nwords;
+};
+
 /* vim:set ts=4 sw=4 et: */
@@ -29,7 +29,10 @@
 //
 **************************************************************************/
 
+#include "sub_sse2.h"
+
 #define SUB(f, N, T, get, set)                                                                     \
+    SUB_SSE2(f, N, T, filter)                                                                      \
     byte *b = f->buf;                                                                              \
     unsigned l = f->buf_len / sizeof(T);                                                           \
     int i;                                                                                         \
@@ -54,6 +57,7 @@
     return 0;
 
 #define ADD(f, N, T, get, set)                                                                     \
+    SUB_SSE2(f, N, T, unfilter)                                                                    \
     byte *b = f->buf;                                                                              \
     unsigned l = f->buf_len / sizeof(T);                                                           \
     int i;                                                                                         \
@@ -0,0 +1,194 @@
+/* sub_sse2.h -- SSE2 versions of the simple delta filters
+
+   This file is part of the UPX executable compressor.
+
+   Copyright (C) 1996-2024 Markus Franz Xaver Johannes Oberhumer
+   Copyright (C) 1996-2024 Laszlo Molnar
+   All Rights Reserved.
+
+   UPX and the UCL library are free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+   Markus F.X.J. Oberhumer              Laszlo Molnar
+   <markus@oberhumer.com>               <ezerotven+github@gmail.com>
+ */
+
+#pragma once
+
+// The delta filters in sub.hh compute y[k] = x[k] - x[k-N] (filter) and
+// x[k] = y[k] + x[k-N] (unfilter) on little-endian elements of type T.
+// With a stride of S = N * sizeof(T) bytes dividing 16 this maps nicely
+// onto SSE2:
+//   - filter: a vector difference, done backwards so that x[k-N] is
+//     still unmodified when it gets loaded
+//   - unfilter: an in-register prefix sum with shifts of S, 2S, 4S, ...
+//     plus the last S bytes of the previous block broadcast as carry
+// N == 3 has no such stride and stays scalar.
+// SSE2 is part of the amd64 baseline, so it is selected at compile time.
+
+#if (ACC_ARCH_AMD64 || ACC_ARCH_I386) && defined(__SSE2__)
+#define WITH_SUB_SSE2 1
+#include <emmintrin.h>
+#else
+#define WITH_SUB_SSE2 0
+#endif
+
+#if WITH_SUB_SSE2
+
+namespace sub_sse2 {
+
+template <class T>
+static forceinline __m128i add(__m128i a, __m128i b) {
+    if (sizeof(T) == 1)
+        return _mm_add_epi8(a, b);
+    else if (sizeof(T) == 2)
+        return _mm_add_epi16(a, b);
+    else
+        return _mm_add_epi32(a, b);
+}
+
+template <class T>
+static forceinline __m128i sub(__m128i a, __m128i b) {
+    if (sizeof(T) == 1)
+        return _mm_sub_epi8(a, b);
+    else if (sizeof(T) == 2)
+        return _mm_sub_epi16(a, b);
+    else
+        return _mm_sub_epi32(a, b);
+}
+
+// prefix sum with stride S bytes inside one vector
+template <class T, unsigned S>
+static forceinline __m128i prefix(__m128i v) {
+    if constexpr (S < 16)
+        v = add<T>(v, _mm_slli_si128(v, S));
+    if constexpr (2 * S < 16)
+        v = add<T>(v, _mm_slli_si128(v, 2 * S));
+    if constexpr (4 * S < 16)
+        v = add<T>(v, _mm_slli_si128(v, 4 * S));
+    if constexpr (8 * S < 16)
+        v = add<T>(v, _mm_slli_si128(v, 8 * S));
+    return v;
+}
+
+// broadcast the last S bytes of v
+template <unsigned S>
+static forceinline __m128i carry(__m128i v) {
+    if constexpr (S == 1) {
+        v = _mm_unpackhi_epi8(v, v);
+        v = _mm_shufflehi_epi16(v, 0xff);
+        return _mm_shuffle_epi32(v, 0xff);
+    } else if constexpr (S == 2) {
+        v = _mm_shufflehi_epi16(v, 0xff);
+        return _mm_shuffle_epi32(v, 0xff);
+    } else if constexpr (S == 4) {
+        return _mm_shuffle_epi32(v, 0xff);
+    } else if constexpr (S == 8) {
+        return _mm_unpackhi_epi64(v, v);
+    } else {
+        static_assert(S == 16);
+        return v;
+    }
+}
+
+// scalar element access; must match get/set in sub8.h/sub16.h/sub32.h
+template <class T>
+static forceinline unsigned get(const byte *p) {
+    if (sizeof(T) == 1)
+        return *p;
+    else if (sizeof(T) == 2)
+        return get_le16(p);
+    else
+        return get_le32(p);
+}
+template <class T>
+static forceinline void set(byte *p, unsigned v) {
+    if (sizeof(T) == 1)
+        *p = (byte) v;
+    else if (sizeof(T) == 2)
+        set_le16(p, v);
+    else
+        set_le32(p, v);
+}
+
+// y[k] = x[k] - x[k-N] for n elements; returns false if not supported
+template <class T, unsigned N>
+static bool filter(byte *b, unsigned n) {
+    constexpr unsigned S = N * sizeof(T);
+    if constexpr (16 % S != 0) {
+        UNUSED(b);
+        UNUSED(n);
+        return false;
+    } else {
+        const unsigned bytes = n * sizeof(T);
+        unsigned o = bytes;
+        // full vectors, backwards; the first N elements stay unchanged
+        while (o >= S + 16) {
+            o -= 16;
+            const __m128i cur = _mm_loadu_si128((const __m128i *) (b + o));
+            const __m128i prev = _mm_loadu_si128((const __m128i *) (b + o - S));
+            _mm_storeu_si128((__m128i *) (b + o), sub<T>(cur, prev));
+        }
+        // remaining head, backwards
+        for (unsigned k = o / sizeof(T); k-- > N;) {
+            byte *const p = b + k * sizeof(T);
+            set<T>(p, get<T>(p) - get<T>(p - S));
+        }
+        return true;
+    }
+}
+
+// x[k] = y[k] + x[k-N] for n elements; returns false if not supported
+template <class T, unsigned N>
+static bool unfilter(byte *b, unsigned n) {
+    constexpr unsigned S = N * sizeof(T);
+    if constexpr (16 % S != 0) {
+        UNUSED(b);
+        UNUSED(n);
+        return false;
+    } else {
+        const unsigned bytes = n * sizeof(T);
+        unsigned o = 0;
+        __m128i c = _mm_setzero_si128(); // x[k] == 0 for k < 0
+        for (; o + 16 <= bytes; o += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *) (b + o));
+            v = add<T>(prefix<T, S>(v), c);
+            _mm_storeu_si128((__m128i *) (b + o), v);
+            c = carry<S>(v);
+        }
+        // remaining tail, forwards
+        for (unsigned k = upx::umax(o / (unsigned) sizeof(T), N); k < n; k++) {
+            byte *const p = b + k * sizeof(T);
+            set<T>(p, get<T>(p) + get<T>(p - S));
+        }
+        return true;
+    }
+}
+
+} // namespace sub_sse2
+
+// used at the start of the SUB and ADD macros in sub.hh
+#define SUB_SSE2(f, N, T, fn)                                                                      \
+    if (sub_sse2::fn<T, N>(f->buf, f->buf_len / sizeof(T))) {                                      \
+        f->calls = (f->buf_len / sizeof(T)) - N;                                                   \
+        assert((int) f->calls > 0);                                                                \
+        return 0;                                                                                  \
+    }
+
+#else
+#define SUB_SSE2(f, N, T, fn) /*empty*/
+#endif // WITH_SUB_SSE2
+
+/* vim:set ts=4 sw=4 et: */
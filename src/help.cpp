@@ -248,6 +248,7 @@ void show_help(int verbose) {
                     "  --lzma              try LZMA [slower but tighter than NRV]\n"
                     "  --brute             try all available compression methods & filters [slow]\n"
                     "  --ultra-brute       try even more compression variants [very slow]\n"
+                    "  --time-budget=SECS  stop --brute after SECS seconds per file, keep the best\n"
                     "\n");
         fg = con_fg(f, FG_YELLOW);
         con_fprintf(f, "Backup options:\n");
@@ -276,6 +277,10 @@ void show_help(int verbose) {
                     "  --no-mode           do not preserve file mode (aka permissions)\n"
                     "  --no-owner          do not preserve file ownership\n"
                     "  --no-time           do not preserve file timestamp\n"
+#if defined(__unix__) || defined(__APPLE__)
+                    "  --serve=SOCKET      run as a pack server on a Unix socket (first arg only)\n"
+                    "  --connect=SOCKET    run this command line in a pack server (first arg only)\n"
+#endif
                     "\n");
         fg = con_fg(f, FG_YELLOW);
         con_fprintf(f, "Options for djgpp2/coff:\n");
@@ -337,11 +342,13 @@ void show_help(int verbose) {
         fg = con_fg(f, fg);
         con_fprintf(f,
                     "  --preserve-build-id     copy .gnu.note.build-id to compressed output\n"
+                    "  --huge-pages            amd64: 2 MiB aligned load address for large .text\n"
                     "\n");
     }
     // clang-format on
 
-    con_fprintf(f, "file..   executables to (de)compress\n");
+    con_fprintf(f, "file..   executables to (de)compress; \"-\" is stdin, "
+                   "\"./-\" a file named -\n");
 
     if (verbose > 0) {
         fg = con_fg(f, FG_YELLOW);
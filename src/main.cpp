@@ -31,6 +31,7 @@
 #include "packer.h"            // Packer::isValidCompressionMethod()
 #include "p_elf.h"             // ELFOSABI_xxx
 #include "compress/compress.h" // upx_ucl_init()
+#include "ui.h"                   // UiPacker::uiReset()
 
 /*************************************************************************
 // options
@@ -65,6 +66,7 @@ static void handle_opterr(acc_getopt_p g, const char *f, void *v) {
 **************************************************************************/
 
 static int exit_code = EXIT_OK;
+static bool serve_job = false; // see upx_main_serve_job()
 
 #if (WITH_GUI)
 static noinline void do_exit(void) { throw exit_code; }
@@ -75,6 +77,8 @@ static void do_exit(void) __attribute__((__noreturn__));
 static void do_exit(void) {
     static bool in_exit = false;
 
+    if (serve_job) // only end the job, not the server
+        throw exit_code;
     if (in_exit)
         exit(exit_code);
     in_exit = true;
@@ -163,9 +167,25 @@ static void check_not_both(bool e1, bool e2, const char *c1, const char *c2) {
     }
 }
 
-static void check_and_update_options(int i, int argc) {
+static void check_and_update_options(int i, int argc, char *argv[]) {
     assert(i <= argc);
 
+    // "-" reads from stdin and, unless "-o" is given, writes to stdout
+    for (int k = i; k < argc; k++) {
+        if (strcmp(argv[k], "-") != 0)
+            continue;
+        if (i + 1 != argc) {
+            fprintf(stderr, "%s: need exactly one argument when reading from stdin\n", argv0);
+            e_usage();
+        }
+        if (!opt->output_name && (opt->cmd == CMD_COMPRESS || opt->cmd == CMD_DECOMPRESS)) {
+            opt->to_stdout = true;
+            // the console output also goes to stdout, so stay quiet
+            if (opt->verbose > 0)
+                opt->verbose = 0;
+        }
+    }
+
     if (opt->cmd != CMD_COMPRESS) {
         // invalidate compression options
         opt->method = 0;
@@ -190,10 +210,6 @@ static void check_and_update_options(int i, int argc) {
         opt->backup = 1;
 
     check_not_both(opt->to_stdout, opt->output_name != nullptr, "--stdout", "-o");
-    if (opt->to_stdout && opt->cmd == CMD_COMPRESS) {
-        fprintf(stderr, "%s: cannot use '--stdout' when compressing\n", argv0);
-        e_usage();
-    }
     if (opt->to_stdout || opt->output_name) {
         if (i + 1 != argc) {
             fprintf(stderr, "%s: need exactly one argument when using '%s'\n", argv0,
@@ -584,6 +600,9 @@ static int do_option(int optc, const char *arg) {
     case 525: // --exact
         opt->exact = true;
         break;
+    case 532: // --time-budget=
+        getoptvar(&opt->time_budget, 1u, 1000000u, arg);
+        break;
     // CRP - Compression Runtime Parameters (undocumented and subject to change)
     case 801:
         getoptvar(&opt->crp.crp_ucl.c_flags, 0, 3, arg);
@@ -738,6 +757,9 @@ static int do_option(int optc, const char *arg) {
     case 677:
         opt->o_unix.force_pie = true;
         break;
+    case 678:
+        opt->o_unix.huge_pages = true;
+        break;
     // ps1/exe
     case 670:
         opt->ps1_exe.boot_only = true;
@@ -901,6 +923,7 @@ int main_get_options(int argc, char **argv) {
         {"filter", 0x31, N, 521}, // --filter=
         {"no-filter", 0x10, N, 522},
         {"small", 0x10, N, 520},
+        {"time-budget", 0x31, N, 532}, // --time-budget=
         // CRP - Compression Runtime Parameters (undocumented and subject to change)
         {"crp-nrv-cf", 0x31, N, 801},
         {"crp-nrv-sl", 0x31, N, 802},
@@ -952,6 +975,7 @@ int main_get_options(int argc, char **argv) {
         {"preserve-build-id", 0, N, 675},
         {"android-shlib", 0, N, 676},
         {"force-pie", 0x90, N, 677},
+        {"huge-pages", 0x10, N, 678}, // amd64-linux: MADV_HUGEPAGE for large .text
         // ps1/exe
         {"boot-only", 0x90, N, 670},
         {"no-align", 0x90, N, 671},
@@ -1062,7 +1086,8 @@ void main_get_envoptions() {
         {"color", 0x10, N, 514},
 
         // compression settings
-        {"exact", 0x10, N, 525}, // user requires byte-identical decompression
+        {"exact", 0x10, N, 525},       // user requires byte-identical decompression
+        {"time-budget", 0x31, N, 532}, // --time-budget=
 
         // compression method
         {"nrv2b", 0x10, N, 702},   // --nrv2b
@@ -1200,7 +1225,7 @@ int upx_main(int argc, char *argv[]) may_throw {
     argv0 = argv[0];
 
     upx_compiler_sanity_check();
-    int dt_res = upx_doctest_check(argc, argv);
+    int dt_res = serve_job ? 0 : upx_doctest_check(argc, argv);
     if (dt_res != 0) {
         if (dt_res == 2)
             fprintf(stderr, "%s: doctest requested program exit; Stop.\n", argv0);
@@ -1238,20 +1263,30 @@ int upx_main(int argc, char *argv[]) may_throw {
 
     set_term(stderr);
 
+    if (!serve_job) { // a serve job reuses the codecs of the server
 #if (WITH_BZIP2)
-    assert(upx_bzip2_init() == 0);
+        assert(upx_bzip2_init() == 0);
 #endif
-    assert(upx_lzma_init() == 0);
+        assert(upx_lzma_init() == 0);
 #if (WITH_NRV)
-    assert(upx_nrv_init() == 0);
+        assert(upx_nrv_init() == 0);
 #endif
-    assert(upx_ucl_init() == 0);
+        assert(upx_ucl_init() == 0);
 #if (WITH_ZLIB)
-    assert(upx_zlib_init() == 0);
+        assert(upx_zlib_init() == 0);
 #endif
 #if (WITH_ZSTD)
-    assert(upx_zstd_init() == 0);
+        assert(upx_zstd_init() == 0);
 #endif
+    }
+
+    // persistent server and its client; must be the first option
+    if (argc >= 2 && !serve_job) {
+        if (strncmp(argv[1], "--serve=", 8) == 0 && argc == 2)
+            return upx_serve(argv[1] + 8);
+        if (strncmp(argv[1], "--connect=", 10) == 0)
+            return upx_connect(argv[1] + 10, argc - 2, argv + 2);
+    }
 
     /* get options */
     first_options(argc, argv);
@@ -1301,7 +1336,7 @@ int upx_main(int argc, char *argv[]) may_throw {
     if (argc == 1)
         e_help();
     set_term(stderr);
-    check_and_update_options(i, argc);
+    check_and_update_options(i, argc, argv);
     int num_files = argc - i;
     if (num_files < 1) {
         if (opt->verbose >= 2)
@@ -1311,7 +1346,7 @@ int upx_main(int argc, char *argv[]) may_throw {
     }
 
     /* start work */
-    set_term(stdout);
+    set_term(opt->to_stdout ? stderr : stdout);
     if (do_files(i, argc, argv) != 0)
         return exit_code;
 
@@ -1321,7 +1356,7 @@ int upx_main(int argc, char *argv[]) may_throw {
         if (is_envvar_true("UPX_DEBUG_DISABLE_GITREV_WARNING"))
             warn_gitrev = false;
         if (warn_gitrev) {
-            FILE *f = stdout;
+            FILE *f = opt->to_stdout ? stderr : stdout;
             int fg = con_fg(f, FG_RED);
             con_fprintf(
                 f, "\nWARNING: this is an unstable beta version - use for testing only! Really.\n");
@@ -1333,11 +1368,36 @@ int upx_main(int argc, char *argv[]) may_throw {
     return exit_code;
 }
 
+/*************************************************************************
+// one job of "upx --serve"; see serve.cpp
+**************************************************************************/
+
+int upx_main_serve_job(int argc, char *argv[]) noexcept {
+    serve_job = true;
+    exit_code = EXIT_OK;
+    UiPacker::uiReset();
+    int r;
+    try {
+        r = upx_main(argc, argv);
+    } catch (int) { // from do_exit()
+        r = exit_code;
+    } catch (const Throwable &e) {
+        printErr("unknown", e);
+        r = EXIT_ERROR;
+    } catch (...) {
+        printErr("unknown", "unhandled exception");
+        r = EXIT_ERROR;
+    }
+    serve_job = false;
+    return r;
+}
+
 /*************************************************************************
 // real entry point
 **************************************************************************/
 
-#if !(WITH_GUI)
+// UPX_CONFIG_LIBRARY: built as upx_lib; see upx_lib.h
+#if !(WITH_GUI) && !(UPX_CONFIG_LIBRARY)
 
 #if 1 && (ACC_OS_DOS32) && defined(__DJGPP__)
 #include <crt0.h>
@@ -1389,6 +1449,6 @@ int __acc_cdecl_main main(int argc, char *argv[]) /*noexcept*/ {
     return r;
 }
 
-#endif /* !(WITH_GUI) */
+#endif /* !(WITH_GUI) && !(UPX_CONFIG_LIBRARY) */
 
 /* vim:set ts=4 sw=4 et: */
@@ -179,6 +179,12 @@ TEST_CASE("getopt") {
         CHECK(opt->all_methods_use_lzma == -1);
         CHECK(opt->method == -1);
     }
+    SUBCASE("--time-budget") {
+        const char *a[] = {a0, "--brute", "--time-budget=30", nullptr};
+        test_options(a);
+        CHECK(opt->all_methods);
+        CHECK(opt->time_budget == 30);
+    }
 
     opt = saved_opt;
 }
@@ -74,6 +74,7 @@ struct Options final {
     bool no_filter;   // force no filter
     bool prefer_ucl;  // prefer UCL
     bool exact;       // user requires byte-identical decompression
+    unsigned time_budget; // --time-budget: seconds per file for --brute; 0 == unlimited
 
     // other options
     int backup;
@@ -160,6 +161,7 @@ struct Options final {
         bool preserve_build_id; // copy the build-id to the compressed binary
         bool android_shlib;     // keep some ElfXX_Shdr for dlopen()
         bool force_pie;         // choose DF_1_PIE instead of is_shlib
+        bool huge_pages;        // 2 MiB aligned PF_X PT_LOAD via MADV_HUGEPAGE
     } o_unix;
     struct {
         bool boot_only;
@@ -249,6 +249,7 @@ PackLinuxElf::PackLinuxElf(InputFile *f)
     o_elf_shnum(0)
 {
     memset(dt_table, 0, sizeof(dt_table));
+    dt_table_base = nullptr;
     symnum_max = 0;
     user_init_rp = nullptr;
 }
@@ -730,6 +731,29 @@ off_t PackLinuxElf64::pack3(OutputFile *fo, Filter &ft)
         u64_t abrk = getbrk(phdri, e_phnum);
         // vbase handles ET_EXEC.  FIXME: pre-linking?
         u64_t const vbase = get_te64(&elfout.phdr[C_BASE].p_vaddr);
+        if (opt->o_unix.huge_pages && Elf64_Ehdr::EM_X86_64 == e_machine) {
+            // Record 2 MiB alignment as .p_align of C_BASE: the kernel then
+            // places ET_DYN on a 2 MiB boundary, so that the de-compressed
+            // large PF_X PT_LOAD can get transparent huge pages.
+            u64_t const hpage = 1ull << 21;
+            bool large_text = false;
+            for (unsigned j = 0; j < e_phnum; ++j) {
+                if (is_LOAD64(&phdri[j])
+                &&  (Elf64_Phdr::PF_X & get_te32(&phdri[j].p_flags))
+                &&  hpage <= get_te64(&phdri[j].p_memsz)) {
+                    large_text = true;
+                }
+            }
+            if (!large_text) {
+                info("--huge-pages ignored: no PF_X PT_LOAD of 2 MiB or more");
+            }
+            else if (0 != (vbase & (hpage - 1))) {
+                info("--huge-pages ignored: load address is not 2 MiB aligned");
+            }
+            else {
+                set_te64(&elfout.phdr[C_BASE].p_align, hpage);
+            }
+        }
         set_te64(&elfout.phdr[C_BASE].p_filesz, 0x1000);  // Linux kernel SIGSEGV if (0==.p_filesz)
         set_te64(&elfout.phdr[C_BASE].p_memsz, abrk - vbase);
         set_te32(&elfout.phdr[C_BASE].p_flags, Elf64_Phdr::PF_W|Elf64_Phdr::PF_R);
@@ -2080,12 +2104,15 @@ PackLinuxElf32::invert_pt_dynamic(Elf32_Dyn const *dynp, u32_t headway)
                     (unsigned)d_tag, -1+ dt_table[d_tag], ndx);
                 throwCantPack(msg);
             }
-            dt_table[d_tag] = 1+ ndx;
+            if (!dt_table[d_tag]) {
+                dt_table[d_tag] = 1+ ndx;
+            }
         }
         if (Elf32_Dyn::DT_NULL == d_tag) {
             break;  // check here so that dt_table[DT_NULL] is set
         }
     }
+    dt_table_base = dynp0;
     sort_DT32_offsets(dynp0);
 
     upx_dt_init = 0;
@@ -3915,7 +3942,13 @@ void PackLinuxElf32::pack1(OutputFile * /*fo*/, Filter &ft)
         unsigned max_offset = 0;
         unsigned sz_best= ~0u;
         int method_best = 0;
+        unsigned tried_one = 0;  // compression candidates of one whole method
         for (unsigned k = 0; k < nmethods; ++k) { // FIXME: parallelize; cost: working space
+            if (k && isTimeBudgetExpired()) {  // keep the best complete method
+                time_budget_skipped += (nmethods - k) * tried_one;
+                break;
+            }
+            unsigned const tried_before = time_budget_tried;
             unsigned sz_this = 0;
             Elf32_Phdr *phdr = phdri;
             for (unsigned j=0; j < e_phnum; ++phdr, ++j) {
@@ -3957,6 +3990,8 @@ void PackLinuxElf32::pack1(OutputFile * /*fo*/, Filter &ft)
                 compressWithFilters(&ft, OVERHEAD, NULL_cconf, 10, true);
                 sz_this += ph.c_len;
             }
+            if (!k)
+                tried_one = time_budget_tried - tried_before;
             // FIXME: loader size also depends on method
             if (sz_best > sz_this) {
                 sz_best = sz_this;
@@ -4804,7 +4839,13 @@ void PackLinuxElf64::pack1(OutputFile * /*fo*/, Filter &ft)
         unsigned max_offset = 0;
         unsigned sz_best= ~0u;
         int method_best = 0;
+        unsigned tried_one = 0;  // compression candidates of one whole method
         for (unsigned k = 0; k < nmethods; ++k) { // FIXME: parallelize; cost: working space
+            if (k && isTimeBudgetExpired()) {  // keep the best complete method
+                time_budget_skipped += (nmethods - k) * tried_one;
+                break;
+            }
+            unsigned const tried_before = time_budget_tried;
             unsigned sz_this = 0;
             Elf64_Phdr *phdr = phdri;
             for (unsigned j=0; j < e_phnum; ++phdr, ++j) {
@@ -4846,6 +4887,8 @@ void PackLinuxElf64::pack1(OutputFile * /*fo*/, Filter &ft)
                 compressWithFilters(&ft, OVERHEAD, NULL_cconf, 10, true);
                 sz_this += ph.c_len;
             }
+            if (!k)
+                tried_one = time_budget_tried - tried_before;
             // FIXME: loader size also depends on method
             if (sz_best > sz_this) {
                 sz_best = sz_this;
@@ -7751,6 +7794,14 @@ Elf32_Dyn *PackLinuxElf32::elf_find_dynptr(unsigned int key) const
     Elf32_Dyn *dynp= dynseg;
     if (dynp) {
         Elf32_Dyn *const last = (Elf32_Dyn *)(sz_dynseg + (char *)dynseg);
+        // Fast path: dt_table[] already knows the first entry of each
+        // small tag.  Re-check the tag, as a few d_tag are rewritten later.
+        if (key < DT_NUM && dt_table[key] && dt_table_base == dynseg) {
+            Elf32_Dyn *const hit = &dynseg[-1+ dt_table[key]];
+            if (hit < last && get_te32(&hit->d_tag) == key) {
+                return hit;
+            }
+        }
         for (; dynp < last; ++dynp) {
             if (get_te32(&dynp->d_tag)==key) {
                 return dynp;
@@ -7768,6 +7819,14 @@ Elf64_Dyn *PackLinuxElf64::elf_find_dynptr(unsigned int key) const
     Elf64_Dyn *dynp= dynseg;
     if (dynp) {
         Elf64_Dyn *const last = (Elf64_Dyn *)(sz_dynseg + (char *)dynseg);
+        // Fast path: dt_table[] already knows the first entry of each
+        // small tag.  Re-check the tag, as a few d_tag are rewritten later.
+        if (key < DT_NUM && dt_table[key] && dt_table_base == dynseg) {
+            Elf64_Dyn *const hit = &dynseg[-1+ dt_table[key]];
+            if (hit < last && get_te64(&hit->d_tag) == key) {
+                return hit;
+            }
+        }
         for (; dynp < last; ++dynp) {
             if (get_te64(&dynp->d_tag)==key) {
                 return dynp;
@@ -8013,12 +8072,15 @@ PackLinuxElf64::invert_pt_dynamic(Elf64_Dyn const *dynp, upx_uint64_t headway)
                     (unsigned)d_tag, -1+ dt_table[d_tag], ndx);
                 throwCantPack(msg);
             }
-            dt_table[d_tag] = 1+ ndx;
+            if (!dt_table[d_tag]) {
+                dt_table[d_tag] = 1+ ndx;
+            }
         }
         if (Elf64_Dyn::DT_NULL == d_tag) {
             break;  // check here so that dt_table[DT_NULL] is set
         }
     }
+    dt_table_base = dynp0;
     sort_DT64_offsets(dynp0);
 
     upx_dt_init = 0;
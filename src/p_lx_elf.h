@@ -118,7 +118,8 @@ protected:
     char const *osabi_note;
     unsigned upx_dt_init;  // DT_INIT, DT_PREINIT_ARRAY, DT_INIT_ARRAY
     static unsigned const DT_NUM = 34;  // elf.h
-    unsigned dt_table[DT_NUM];  // 1+ index of DT_xxxxx in PT_DYNAMIC
+    unsigned dt_table[DT_NUM];  // 1+ index of first DT_xxxxx in PT_DYNAMIC
+    void const *dt_table_base;  // the PT_DYNAMIC that dt_table[] describes
 
     MemBuffer mb_shstrtab;   // via ElfXX_Shdr
     char const *shstrtab;
@@ -346,10 +346,24 @@ void PackUnix::packExtent(
         int l = fi->readx(hdr_ibuf, hdr_u_len);
         (void)l;
     }
+    // Compress straight from a mapping of the input if possible; then
+    // ibuf is only used (and touched) as the scratch copy for filtering.
+    const upx_byte *const image = fi->view(x.offset, x.size);
     fi->seek(x.offset, SEEK_SET);
     for (off_t rest = x.size; 0 != rest; ) {
         int const filter_strategy = ft ? getStrategy(*ft) : 0;
-        int l = fi->readx(ibuf, UPX_MIN(rest, (off_t)blocksize));
+        int l;
+        upx_byte *in = ibuf;  // uncompressed data of this block
+        if (image) {
+            l = (int) UPX_MIN(rest, (off_t)blocksize);
+            in = const_cast<upx_byte *>(image + (x.size - rest));
+            if (ft) {  // filters work in place
+                memcpy(ibuf, in, l);
+                in = ibuf;
+            }
+        }
+        else
+            l = fi->readx(ibuf, UPX_MIN(rest, (off_t)blocksize));
         if (l == 0) {
             break;
         }
@@ -379,12 +393,12 @@ void PackUnix::packExtent(
                                 0, 0, 0, hdr_ibuf, hdr_u_len, inhibit_compression_check);
         }
         else {
-            (void) compress(ibuf, ph.u_len, obuf);    // ignore return value
+            (void) compress(in, ph.u_len, obuf);    // ignore return value
         }
 
         if (ph.c_len < ph.u_len) {
             const upx_bytep tbuf = nullptr;
-            if (ft == nullptr || ft->id == 0) tbuf = ibuf;
+            if (ft == nullptr || ft->id == 0) tbuf = in;
             ph.overlap_overhead = OVERHEAD;
             if (!testOverlappingDecompression(obuf, tbuf, ph.overlap_overhead)) {
                 // not in-place compressible
@@ -394,9 +408,9 @@ void PackUnix::packExtent(
         if (ph.c_len >= ph.u_len) {
             // block is not compressible
             ph.c_len = ph.u_len;
-            memcpy(obuf, ibuf, ph.c_len);
+            memcpy(obuf, in, ph.c_len);
             // must update checksum of compressed data
-            ph.c_adler = upx_adler32(ibuf, ph.u_len, init_c_adler);
+            ph.c_adler = upx_adler32(in, ph.u_len, init_c_adler);
         }
 
         // write block sizes
@@ -413,7 +427,7 @@ void PackUnix::packExtent(
                 throwInternalError("header compression size increase");
             ph.saved_u_adler = upx_adler32(hdr_ibuf, hdr_u_len, init_u_adler);
             ph.saved_c_adler = upx_adler32(hdr_obuf, hdr_c_len, init_c_adler);
-            ph.u_adler = upx_adler32(ibuf, ph.u_len, ph.saved_u_adler);
+            ph.u_adler = upx_adler32(in, ph.u_len, ph.saved_u_adler);
             ph.c_adler = upx_adler32(obuf, ph.c_len, ph.saved_c_adler);
             end_u_adler = ph.u_adler;
             memset(&tmp, 0, sizeof(tmp));
@@ -455,12 +469,14 @@ void PackUnix::packExtent(
             verifyOverlappingDecompression(ft);
         }
         else {
-            fo->write(ibuf, ph.u_len);
+            fo->write(in, ph.u_len);
             total_out += ph.u_len;
         }
 
         total_in += ph.u_len;
     }
+    if (image)
+        fi->seek(x.offset + x.size, SEEK_SET);  // as if read
 }
 
 // Consumes b_info header block and sz_cpr data block from input file 'fi'.
@@ -592,6 +608,64 @@ int PackUnix::find_overlay_offset(MemBuffer const &buf)
     return true;
 }
 
+/*************************************************************************
+// fileInfo: the layout of the b_info blocks which follow the p_info;
+// every block is listed with -vvv.
+// The ELF formats put more data (e.g. the loader) after the first run of
+// blocks, so the walk just stops at a header which does not look like a
+// b_info.
+**************************************************************************/
+
+void PackUnix::fileInfo()
+{
+    if (ph.version <= 11 || ph.c_len == 0)
+        return;  // not packed, or no p_info
+    upx_off_t const end = fi->st_size();
+    if (overlay_offset <= 0 || (upx_off_t)(overlay_offset + sizeof(p_info)) > end)
+        return;
+    p_info hbuf;
+    fi->seek(overlay_offset, SEEK_SET);
+    fi->readx(&hbuf, sizeof(hbuf));
+    unsigned const bsize = get_te32(&hbuf.p_blocksize);
+    if (get_te32(&hbuf.p_filesize) != ph.u_file_size
+    ||  bsize == 0 || bsize > ph.u_file_size)
+        return;  // some other layout
+
+    upx_off_t const start = fi->tell();
+    for (int pass = 0; pass < 2; pass++) {
+        unsigned nblocks = 0;
+        bool complete = false;
+        upx_off_t pos = start;
+        b_info hdr; memset(&hdr, 0, sizeof(hdr));
+        while (pos + (upx_off_t)szb_info <= end) {
+            fi->seek(pos, SEEK_SET);
+            fi->readx(&hdr, szb_info);
+            unsigned const sz_unc = get_te32(&hdr.sz_unc);
+            unsigned const sz_cpr = get_te32(&hdr.sz_cpr);
+            if (sz_unc == 0) { // uncompressed size 0 -> EOF
+                // note: magic is always stored le32
+                complete = (get_le32(&hdr.sz_cpr) == UPX_MAGIC_LE32);
+                break;
+            }
+            if (sz_cpr == 0 || sz_cpr > sz_unc || sz_unc > bsize
+            ||  (upx_off_t)sz_cpr > end - (pos + szb_info))
+                break;
+            if (pass)
+                con_fprintf(stdout, "    block %4u  at 0x%08llx  %8u -> %8u"
+                    "  method %2u  filter 0x%02x/0x%02x\n", nblocks,
+                    (unsigned long long) pos, sz_unc, sz_cpr,
+                    hdr.b_method, hdr.b_ftid, hdr.b_cto8);
+            nblocks++;
+            pos += szb_info + sz_cpr;
+        }
+        if (!pass)
+            con_fprintf(stdout, "    %u block%s, blocksize %u%s\n", nblocks,
+                (1 == nblocks ? "" : "s"), bsize, (complete ? "" : " (first run)"));
+        if (opt->verbose < 3)
+            break;
+    }
+}
+
 /*************************************************************************
 // Generic Unix unpack().
 //
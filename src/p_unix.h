@@ -59,6 +59,9 @@ public:
     virtual tribool canUnpack() override; // bool, except -1: format known, but not packed
     int find_overlay_offset(MemBuffer const &buf);
 
+protected:
+    virtual void fileInfo() override;
+
 protected:
     // called by the generic pack()
     virtual void pack1(OutputFile *, Filter &);  // generate executable header
@@ -90,10 +90,26 @@ void Packer::assertPacker() const {
 // public entries called from class PackMaster
 **************************************************************************/
 
+static upx_uint64_t get_msec() noexcept {
+    using namespace std::chrono;
+    return (upx_uint64_t) duration_cast<milliseconds>(steady_clock::now().time_since_epoch())
+        .count();
+}
+
 void Packer::doPack(OutputFile *fo) {
     uip->uiPackStart(fo);
+    if (opt->time_budget)
+        time_budget_deadline = get_msec() + 1000ull * opt->time_budget;
     pack(fo);
     uip->uiPackEnd(fo);
+    if (time_budget_skipped)
+        printWarn(fi->getName(),
+                  "--time-budget expired: %u compression candidates tried, %u skipped",
+                  time_budget_tried, time_budget_skipped);
+}
+
+bool Packer::isTimeBudgetExpired() const noexcept {
+    return time_budget_deadline != 0 && get_msec() >= time_budget_deadline;
 }
 
 void Packer::doUnpack(OutputFile *fo) {
@@ -925,6 +941,22 @@ int Packer::prepareMethods(int *methods, int ph_method, const int *all_methods)
         // use this method
         methods[nmethods++] = method;
     }
+    // --time-budget: try the methods with the best expected ratio first
+    if (opt->time_budget && nmethods >= 2) {
+        auto rank = [](int m) noexcept {
+            if (m == M_LZMA)
+                return 0;
+            if (M_IS_NRV2E(m))
+                return 1;
+            if (M_IS_NRV2D(m))
+                return 2;
+            if (M_IS_NRV2B(m))
+                return 3;
+            return 4; // the extra M_LZMA_xxx variants of --ultra-brute
+        };
+        std::stable_sort(methods, methods + nmethods,
+                         [&rank](int a, int b) noexcept { return rank(a) < rank(b); });
+    }
     // debug
     if (opt->debug.use_random_method && nmethods >= 2) {
         int method = methods[upx_rand() % nmethods];
@@ -1006,6 +1038,9 @@ done:
     return nfilters;
 }
 
+// inputs of this size and more are packed with o_ptr[] as the only output buffer
+static constexpr unsigned LOW_MEMORY_COMPRESS_SIZE = 256 * 1024 * 1024;
+
 void Packer::compressWithFilters(byte *i_ptr,
                                  const unsigned i_len, // written and restored by filters
                                  byte *const o_ptr,    // where to put compressed output
@@ -1065,16 +1100,29 @@ void Packer::compressWithFilters(byte *i_ptr,
     // Working buffer for compressed data. Don't waste memory and allocate as needed.
     byte *o_tmp = o_ptr;
     MemBuffer o_tmp_buf;
+    // For very large inputs do not allocate o_tmp_buf at all: every try
+    // compresses directly into o_ptr, and if a later try has overwritten
+    // the best result then the best one is compressed once more at the end.
+    const bool low_memory = i_len >= LOW_MEMORY_COMPRESS_SIZE;
+    bool o_ptr_is_best = false;
+    // lets ft.unfilter() below just undo the patches of ft.filter()
+    FilterUndoLog undo_log;
 
     // compress using all methods/filters
+    // --time-budget: after the first success stop as soon as the budget is
+    // spent, keeping the best result found so far
+    unsigned ntries_done = 0;
+    bool time_budget_expired = false;
     int nfilters_success_total = 0;
-    for (int mm = 0; mm < nmethods; mm++) // for all methods
+    for (int mm = 0; mm < nmethods && !time_budget_expired; mm++) // for all methods
     {
         NO_printf("\nmethod %d (%d of %d)\n", methods[mm], 1 + mm, nmethods);
         assert(isValidCompressionMethod(methods[mm]));
         unsigned hdr_c_len = 0;
         if (hdr_ptr != nullptr && hdr_len) {
-            if (nfilters_success_total != 0 && o_tmp == o_ptr) {
+            if (low_memory)
+                o_ptr_is_best = false;
+            else if (nfilters_success_total != 0 && o_tmp == o_ptr) {
                 // do not overwrite o_ptr
                 o_tmp_buf.allocForCompression(UPX_MAX(hdr_len, i_len));
                 o_tmp = o_tmp_buf;
@@ -1089,6 +1137,15 @@ void Packer::compressWithFilters(byte *i_ptr,
         int nfilters_success_mm = 0;
         for (int ff = 0; ff < nfilters; ff++) // for all filters
         {
+            if (nfilters_success_total > 0 && isTimeBudgetExpired()) {
+                // count the method/filter pairs which are not even tried; filters
+                // which failed above are no candidates and are not counted
+                const int per_method = filter_strategy < 0 ? 1 : nfilters;
+                const int left_mm = filter_strategy < 0 ? 1 : nfilters - ff;
+                time_budget_skipped += left_mm + (nmethods - mm - 1) * per_method;
+                time_budget_expired = true;
+                break;
+            }
             assert(isValidFilter(filters[ff]));
             // get fresh packheader
             ph = orig_ph;
@@ -1098,6 +1155,7 @@ void Packer::compressWithFilters(byte *i_ptr,
             // get fresh filter
             Filter ft = orig_ft;
             ft.init(ph.filter, orig_ft.addvalue);
+            ft.undo_log = &undo_log;
             // filter
             optimizeFilter(&ft, f_ptr, f_len);
             bool success = ft.filter(f_ptr, f_len);
@@ -1118,12 +1176,15 @@ void Packer::compressWithFilters(byte *i_ptr,
             NO_printf("\nfilter: id 0x%02x size %6d, calls %5d/%5d/%3d/%5d/%5d, cto 0x%02x\n",
                       ft.id, ft.buf_len, ft.calls, ft.noncalls, ft.wrongcalls, ft.firstcall,
                       ft.lastcall, ft.cto);
-            if (nfilters_success_total != 0 && o_tmp == o_ptr) {
+            if (low_memory)
+                o_ptr_is_best = false;
+            else if (nfilters_success_total != 0 && o_tmp == o_ptr) {
                 o_tmp_buf.allocForCompression(i_len);
                 o_tmp = o_tmp_buf;
             }
             nfilters_success_total++;
             nfilters_success_mm++;
+            ntries_done++;
             ph.filter_cto = ft.cto;
             ph.n_mru = ft.n_mru;
             // compress
@@ -1166,6 +1227,7 @@ void Packer::compressWithFilters(byte *i_ptr,
                     best_ph_lsize = lsize;
                     best_hdr_c_len = hdr_c_len;
                     best_ft = ft;
+                    o_ptr_is_best = true;
                 }
             }
             // restore - unfilter with verify
@@ -1173,7 +1235,29 @@ void Packer::compressWithFilters(byte *i_ptr,
             if (filter_strategy < 0)
                 break;
         }
-        assert(nfilters_success_mm > 0);
+        assert(nfilters_success_mm > 0 || time_budget_expired);
+    }
+    time_budget_tried += ntries_done;
+
+    // low_memory: redo the best try if o_ptr[] was overwritten since
+    if (low_memory && !o_ptr_is_best && best_ph.c_len < i_len) {
+        if (!ph_is_forced_method(orig_ph.method))
+            uip->ui_total_passes += 1;
+        ph = orig_ph;
+        ph.method = best_ph.method;
+        ph.filter = best_ph.filter;
+        ph.overlap_overhead = 0;
+        Filter ft = orig_ft;
+        ft.init(ph.filter, orig_ft.addvalue);
+        optimizeFilter(&ft, f_ptr, f_len);
+        if (!ft.filter(f_ptr, f_len) || ft.cto != best_ft.cto)
+            throwInternalError("filter mismatch");
+        ph.filter_cto = ft.cto;
+        ph.n_mru = ft.n_mru;
+        if (!compress(i_ptr, i_len, o_ptr, cconf) || ph.c_len != best_ph.c_len ||
+            ph.c_adler != best_ph.c_adler)
+            throwInternalError("compression mismatch");
+        ft.unfilter(f_ptr, f_len, true);
     }
 
     // postconditions 1)
@@ -1185,6 +1269,7 @@ void Packer::compressWithFilters(byte *i_ptr,
 
     // copy back results
     this->ph = best_ph;
+    best_ft.undo_log = nullptr;
     *parm_ft = best_ft;
 
     // Finally, check compression ratio.
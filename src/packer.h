@@ -219,6 +219,8 @@ protected:
     const int *getDefaultCompressionMethods_8(int method, int level, int small = -1) const;
     const int *getDefaultCompressionMethods_le32(int method, int level, int small = -1) const;
     int prepareMethods(int *methods, int ph_method, const int *all_methods) const;
+    // --time-budget; see compressWithFilters()
+    bool isTimeBudgetExpired() const noexcept;
     virtual const char *getDecompressorSections() const;
     virtual unsigned getDecompressorWrkmemSize() const;
     virtual void defineDecompressorSymbols();
@@ -324,6 +326,11 @@ protected:
     // linker
     OwningPointer(Linker) linker = nullptr; // owner
 
+    // --time-budget: deadline of the method/filter search, and its coverage
+    upx_uint64_t time_budget_deadline = 0; // msec of a monotonic clock; 0 == no limit
+    unsigned time_budget_tried = 0;        // compression candidates tried
+    unsigned time_budget_skipped = 0;      // candidates skipped after the deadline
+
 private:
     // private to checkPatch()
     void *last_patch = nullptr;
@@ -31,8 +31,25 @@
 /*************************************************************************
 // sort and delta-compress relocations with optional bswap within image
 // returns number of **bytes** written to 'out'
+//
+// The spans are validated once up front (or after a first checking
+// pass), so the per-reloc loops can run on raw pointers.
 **************************************************************************/
 
+// bytes at image[pc] which must be valid for a reloc
+static inline unsigned reloc_width(int bits, bool bswap) { return bswap ? bits / 8 : 4; }
+
+static inline bool reloc_in_image(unsigned pc, unsigned width, unsigned image_size) {
+    return image_size >= width && pc <= image_size - width; // avoid overflow
+}
+
+static inline void reloc_bswap(byte *p, int bits) {
+    if (bits == 32)
+        set_be32(p, get_le32(p));
+    else
+        set_be64(p, get_le64(p));
+}
+
 /*static*/
 unsigned Packer::optimizeReloc(unsigned relocnum, SPAN_P(byte) relocs, SPAN_S(byte) out,
                                SPAN_P(byte) image, unsigned image_size, int bits, bool bswap,
@@ -43,14 +60,15 @@ unsigned Packer::optimizeReloc(unsigned relocnum, SPAN_P(byte) relocs, SPAN_S(by
     ptr_check_no_overlap(relocs.data(), relocs.size_bytes(), image.data(image_size), image_size,
                          out.data(), out.size_bytes());
 #endif
-    SPAN_S_VAR(byte, fix, out);
 
     *big = 0;
     if (opt->exact)
         throwCantPackExact();
     if (relocnum == 0)
         return 0;
-    upx_qsort(raw_bytes(relocs, 4 * relocnum), relocnum, 4, le32_compare);
+    const byte *const r = raw_bytes(relocs, mem_size(4, relocnum));
+    // linear-time radix sort; duplicates are dropped
+    relocnum = upx_sort_unique_le32(raw_bytes(relocs, 4 * relocnum), relocnum);
     if (0) {
         printf("optimizeReloc: u_reloc %9u checksum=0x%08x\n", 4 * relocnum,
                upx_adler32(relocs, 4 * relocnum));
@@ -58,13 +76,30 @@ unsigned Packer::optimizeReloc(unsigned relocnum, SPAN_P(byte) relocs, SPAN_S(by
                upx_adler32(image, image_size));
     }
 
+    // pass 1: check all relocs and compute the encoded size
+    const unsigned width = reloc_width(bits, bswap);
+    unsigned bytes = 1; // end marker
     unsigned pc = (unsigned) -4;
     for (unsigned i = 0; i < relocnum; i++) {
-        unsigned delta = get_le32(relocs + i * 4) - pc;
+        const unsigned delta = get_le32(r + i * 4) - pc;
         if (delta == 0)
             continue;
         else if ((int) delta < 4)
             throwCantPack("overlapping fixups");
+        bytes += (delta < 0xf0) ? 1 : (delta < 0x100000) ? 3 : 7;
+        pc += delta;
+        if (!reloc_in_image(pc, width, image_size))
+            throwCantPack("bad reloc[%#x] = %#x", i, pc);
+    }
+
+    // pass 2: encode
+    byte *fix = raw_bytes(out, bytes);
+    byte *const img = bswap ? raw_bytes(image, image_size) : nullptr;
+    pc = (unsigned) -4;
+    for (unsigned i = 0; i < relocnum; i++) {
+        const unsigned delta = get_le32(r + i * 4) - pc;
+        if (delta == 0)
+            continue;
         else if (delta < 0xf0)
             *fix++ = (byte) delta;
         else if (delta < 0x100000) {
@@ -80,17 +115,11 @@ unsigned Packer::optimizeReloc(unsigned relocnum, SPAN_P(byte) relocs, SPAN_S(by
             fix += 4;
         }
         pc += delta;
-        if (pc + 4 > image_size)
-            throwCantPack("bad reloc[%#x] = %#x", i, pc);
-        if (bswap) {
-            if (bits == 32)
-                set_be32(image + pc, get_le32(image + pc));
-            else
-                set_be64(image + pc, get_le64(image + pc));
-        }
+        if (bswap)
+            reloc_bswap(img + pc, bits);
     }
     *fix++ = 0; // end marker
-    const unsigned bytes = ptr_udiff_bytes(fix, out);
+    assert(bytes == ptr_udiff_bytes(fix, raw_bytes(out, 0)));
     if (0) {
         printf("optimizeReloc: c_reloc %9u checksum=0x%08x\n", bytes, upx_adler32(out, bytes));
         printf("optimizeReloc: c_image %9u checksum=0x%08x\n", image_size,
@@ -132,36 +161,38 @@ unsigned Packer::unoptimizeReloc(SPAN_S(const byte) & in, MemBuffer &out, SPAN_P
                upx_adler32(image, image_size));
     }
 
+    // the counting loop above has checked all bytes of the encoded relocs
+    const unsigned bytes = ptr_udiff_bytes(fix + 1, in);
+    const byte *p = raw_bytes(in, bytes);
+
     out.alloc(mem_size(4, relocnum + 1)); // one extra entry
-    SPAN_S_VAR(LE32, relocs, out);
+    LE32 *relocs = (LE32 *) raw_bytes(out, mem_size(4, relocnum));
+    byte *const img = bswap ? raw_bytes(image, image_size) : nullptr;
 
-    fix = in;
+    const unsigned width = reloc_width(bits, bswap);
     unsigned pc = (unsigned) -4;
     for (unsigned i = 0; i < relocnum; i++) {
         unsigned delta;
-        if (*fix < 0xf0)
-            delta = *fix++;
+        if (*p < 0xf0)
+            delta = *p++;
         else {
-            delta = (*fix & 0x0f) * 0x10000 + get_le16(fix + 1);
-            fix += 3;
+            delta = (*p & 0x0f) * 0x10000 + get_le16(p + 1);
+            p += 3;
             if (delta == 0) {
-                delta = get_le32(fix);
-                fix += 4;
+                delta = get_le32(p);
+                p += 4;
             }
         }
         if ((int) delta < 4)
             throwCantUnpack("overlapping fixups");
         pc += delta;
-        if (pc + 4 > image_size)
+        if (!reloc_in_image(pc, width, image_size))
             throwCantUnpack("bad reloc[%#x] = %#x", i, pc);
         *relocs++ = pc;
-        if (bswap) {
-            if (bits == 32)
-                set_be32(image + pc, get_le32(image + pc));
-            else
-                set_be64(image + pc, get_le64(image + pc));
-        }
+        if (bswap)
+            reloc_bswap(img + pc, bits);
     }
+    assert(p + 1 == raw_bytes(in, bytes) + bytes);
     in = fix + 1; // advance
     assert(relocnum == ptr_udiff_bytes(relocs, raw_bytes(out, 0)) / 4);
     if (0) {
@@ -173,4 +204,57 @@ unsigned Packer::unoptimizeReloc(SPAN_S(const byte) & in, MemBuffer &out, SPAN_P
     return relocnum;
 }
 
+/*************************************************************************
+//
+**************************************************************************/
+
+namespace {
+struct TestRelocPacker final : public Packer {
+    // make the protected static members accessible
+    using Packer::optimizeReloc;
+    using Packer::unoptimizeReloc;
+};
+} // namespace
+
+static void test_reloc_roundtrip(const unsigned *pos, unsigned n, unsigned image_size,
+                                 unsigned expected_bytes, int expected_big) {
+    MemBuffer image(image_size);
+    for (unsigned i = 0; i < image_size; i++)
+        image[i] = (byte) (i * 13 + 1); // no 4-byte group reads the same backwards
+    MemBuffer orig(image_size);
+    memcpy(orig, image, image_size);
+    MemBuffer relocs(4 * n);
+    for (unsigned i = 0; i < n; i++)
+        set_le32(relocs + 4 * i, pos[i]);
+    MemBuffer out(4 * n + 8192);
+    int big = -1;
+    unsigned bytes = TestRelocPacker::optimizeReloc(n, relocs, out, image, image_size, 32, true, &big);
+    CHECK(big == expected_big);
+    CHECK(bytes == expected_bytes);
+    // each reloc target got byte-swapped exactly once
+    for (unsigned i = 0; i < n; i++)
+        CHECK(get_be32(image + pos[i]) == get_le32(orig + pos[i]));
+    SPAN_S_VAR(const byte, in, out);
+    MemBuffer wrkmem;
+    unsigned relocnum = TestRelocPacker::unoptimizeReloc(in, wrkmem, image, image_size, 32, true);
+    CHECK(relocnum == n - 1); // one duplicate
+    CHECK(ptr_udiff_bytes(in, out) == bytes);
+    for (unsigned i = 1; i < relocnum; i++)
+        CHECK(get_le32(wrkmem + 4 * (i - 1)) < get_le32(wrkmem + 4 * i));
+    CHECK(get_le32(wrkmem + 4 * (relocnum - 1)) == image_size - 4);
+    // bswap twice restores the image
+    CHECK(memcmp(image, orig, image_size) == 0);
+}
+
+TEST_CASE("Packer::optimizeReloc") {
+    // one- and three-byte deltas; the duplicate 8 is dropped
+    static const unsigned pos[] = {0x1ffc, 8, 0, 0x100, 0x104, 0x1100, 8, 0x1000};
+    test_reloc_roundtrip(pos, 8, 0x2000, 1 + 1 + 3 + 1 + 3 + 3 + 3 + 1, 0);
+#if DEBUG
+    // seven-byte deltas need an image of more than 1 MiB
+    static const unsigned big_pos[] = {0x100104, 8, 0, 0x100, 8, 0x100100};
+    test_reloc_roundtrip(big_pos, 6, 0x100108, 1 + 1 + 3 + 7 + 1 + 1, 1);
+#endif
+}
+
 /* vim:set ts=4 sw=4 et: */
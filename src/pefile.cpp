@@ -217,23 +217,16 @@ PeFile::Interval::Interval(SPAN_P(byte) b) : base(b) {}
 
 PeFile::Interval::~Interval() noexcept { ::free(ivarr); }
 
-int __acc_cdecl_qsort PeFile::Interval::compare(const void *p1, const void *p2) {
-    const interval *i1 = (const interval *) p1;
-    const interval *i2 = (const interval *) p2;
-    if (i1->start < i2->start)
-        return -1;
-    if (i1->start > i2->start)
-        return 1;
-    if (i1->len < i2->len)
-        return 1;
-    if (i1->len > i2->len)
-        return -1;
-    return 0;
-}
+// radix sort keys: byte offsets from least to most significant
+#if (ACC_ABI_BIG_ENDIAN)
+static const byte ne32_digits[4] = {3, 2, 1, 0};
+#else
+static const byte ne32_digits[4] = {0, 1, 2, 3};
+#endif
 
 void PeFile::Interval::add_interval(unsigned start, unsigned len) {
     if (ivnum == ivcapacity) {
-        ivcapacity += 15;
+        ivcapacity += 15 + (ivcapacity >> 1); // grow geometrically
         ivarr = (interval *) realloc(ivarr, mem_size(sizeof(interval), ivcapacity));
         assert(ivarr != nullptr);
     }
@@ -258,17 +251,19 @@ void PeFile::Interval::add_interval(const Interval *other) {
 void PeFile::Interval::flatten() {
     if (!ivnum)
         return;
-    upx_qsort(ivarr, ivnum, sizeof(interval), Interval::compare);
-    for (unsigned ic = 0; ic < ivnum - 1; ic++) {
-        unsigned jc;
-        for (jc = ic + 1; jc < ivnum && ivarr[ic].start + ivarr[ic].len >= ivarr[jc].start; jc++)
+    // sort by start only; merging below does not depend on the order of equal starts
+    COMPILE_TIME_ASSERT(offsetof(interval, start) == 0)
+    upx_radixsort(ivarr, ivnum, sizeof(interval), ne32_digits, 4);
+    // merge overlapping and adjacent intervals in one pass
+    unsigned ic = 0;
+    for (unsigned jc = 1; jc < ivnum; jc++) {
+        if (ivarr[ic].start + ivarr[ic].len >= ivarr[jc].start) {
             if (ivarr[ic].start + ivarr[ic].len < ivarr[jc].start + ivarr[jc].len)
                 ivarr[ic].len = ivarr[jc].start + ivarr[jc].len - ivarr[ic].start;
-        if (jc > ic + 1) {
-            memmove(ivarr + ic + 1, ivarr + jc, sizeof(interval) * (ivnum - jc));
-            ivnum -= jc - ic - 1;
-        }
+        } else
+            ivarr[++ic] = ivarr[jc];
     }
+    ivnum = ic + 1;
 }
 
 void PeFile::Interval::clear() {
@@ -299,25 +294,16 @@ static constexpr size_t RELOC_ENTRY_SIZE = 5; // encoded size in bytes; actual e
 static void reloc_entry_encode(SPAN_P(byte) buf, unsigned pos, unsigned reloc_type) {
     if (reloc_type == 0 || reloc_type >= 16)
         throwCantPack("bad reloc_type %#x %u", pos, reloc_type);
-    set_ne32(buf, pos);
+    set_le32(buf, pos);
     buf[4] = (upx_uint8_t) reloc_type;
 }
 static void reloc_entry_decode(SPAN_P(const byte) buf, unsigned *pos, unsigned *reloc_type) {
-    *pos = get_ne32(buf);
+    *pos = get_le32(buf);
     *reloc_type = buf[4];
     assert(*reloc_type > 0 && *reloc_type < 16);
 }
-static int __acc_cdecl_qsort reloc_entry_compare(const void *a, const void *b) {
-    const unsigned pos1 = get_ne32(a);
-    const unsigned pos2 = get_ne32(b);
-    if (pos1 != pos2)
-        return pos1 < pos2 ? -1 : 1;
-    const unsigned reloc_type1 = ((const byte *) a)[4];
-    const unsigned reloc_type2 = ((const byte *) b)[4];
-    if (reloc_type1 != reloc_type2)
-        return reloc_type1 < reloc_type2 ? -1 : 1;
-    return 0;
-}
+// sort key: pos, then reloc_type
+static const byte reloc_entry_digits[5] = {4, 0, 1, 2, 3};
 
 PeFile::Reloc::~Reloc() noexcept {
     COMPILE_TIME_ASSERT(sizeof(BaseReloc) == 8)
@@ -418,8 +404,8 @@ void PeFile::Reloc::add_reloc(unsigned pos, unsigned reloc_type) {
 void PeFile::Reloc::finish(byte *(&result_ptr), unsigned &result_size) {
     assert(start_did_alloc);
     // sort in-place relocs
-    upx_qsort(raw_index_bytes(start_buf, RELOC_INPLACE_OFFSET, RELOC_ENTRY_SIZE * counts[0]),
-              counts[0], RELOC_ENTRY_SIZE, reloc_entry_compare);
+    upx_radixsort(raw_index_bytes(start_buf, RELOC_INPLACE_OFFSET, RELOC_ENTRY_SIZE * counts[0]),
+                  counts[0], RELOC_ENTRY_SIZE, reloc_entry_digits, 5);
 
     auto finish_block = [](SPAN_S(BaseReloc) rel) -> byte * {
         unsigned sob = rel->size_of_block;
@@ -534,13 +520,7 @@ void PeFile32::processRelocs() // pass1
 
     // remove duplicated records
     for (unsigned ic = 1; ic <= IMAGE_REL_BASED_HIGHLOW; ic++) {
-        upx_qsort(fix[ic], xcounts[ic], 4, le32_compare);
-        unsigned prev = ~0u;
-        unsigned jc = 0;
-        for (unsigned kc = 0; kc < xcounts[ic]; kc++)
-            if (fix[ic][kc] != prev)
-                prev = fix[ic][jc++] = fix[ic][kc];
-
+        const unsigned jc = upx_sort_unique_le32(fix[ic], xcounts[ic]);
         NO_printf("reloc xcounts[%u] %u->%u\n", ic, xcounts[ic], jc);
         xcounts[ic] = jc;
     }
@@ -636,13 +616,7 @@ void PeFile64::processRelocs() // pass1
 
     // remove duplicated records
     for (unsigned ic = 1; ic < 16; ic++) {
-        upx_qsort(fix[ic], xcounts[ic], 4, le32_compare);
-        unsigned prev = ~0u;
-        unsigned jc = 0;
-        for (unsigned kc = 0; kc < xcounts[ic]; kc++)
-            if (fix[ic][kc] != prev)
-                prev = fix[ic][jc++] = fix[ic][kc];
-
+        const unsigned jc = upx_sort_unique_le32(fix[ic], xcounts[ic]);
         NO_printf("xcounts[%u] %u->%u\n", ic, xcounts[ic], jc);
         xcounts[ic] = jc;
     }
@@ -392,9 +392,6 @@ protected:
 
         void clear();
         void dump() const;
-
-    private:
-        static int __acc_cdecl_qsort compare(const void *p1, const void *p2);
     };
 
     class Reloc final : private noncopyable {
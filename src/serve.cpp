@@ -0,0 +1,442 @@
+/* serve.cpp -- persistent local pack server
+
+   This file is part of the UPX executable compressor.
+
+   Copyright (C) 1996-2024 Markus Franz Xaver Johannes Oberhumer
+   Copyright (C) 1996-2024 Laszlo Molnar
+   All Rights Reserved.
+
+   UPX and the UCL library are free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+   Markus F.X.J. Oberhumer              Laszlo Molnar
+   <markus@oberhumer.com>               <ezerotven+github@gmail.com>
+ */
+
+// "upx --serve=SOCKET" keeps one warm process around, and
+// "upx --connect=SOCKET [options] files..." hands a command line to it.
+//
+// Protocol over a Unix domain stream socket:
+//   client -> server: the client's stdin, stdout and stderr as SCM_RIGHTS,
+//                     then a LE32 byte count and that many bytes of
+//                     strings: first its working directory, then the
+//                     arguments, each one as a LE32 length and the bytes
+//   server -> client: one byte, the exit code of the job
+// The job writes its output directly to the client's stdout and stderr.
+// The socket is created with mode 0600, and the server only accepts
+// clients that run as the same user.
+
+#include "conf.h"
+#include "util/membuffer.h"
+
+#if defined(__linux__) || defined(__CYGWIN__) || defined(__APPLE__) || defined(__FreeBSD__) ||   \
+    defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#define WITH_SERVE 1
+#else
+#define WITH_SERVE 0
+#endif
+
+#if WITH_SERVE
+
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0 // SIGPIPE is ignored by the server anyway
+#endif
+
+static constexpr unsigned MAX_REQUEST_SIZE = 64 * 1024;
+static constexpr int MAX_ARGS = 256;
+static constexpr unsigned REQUEST_TIMEOUT_MS = 10 * 1000; // then drop a stalled client
+
+static bool make_address(struct sockaddr_un *addr, const char *path) noexcept {
+    mem_clear(addr);
+    addr->sun_family = AF_UNIX;
+    if (!path[0] || strlen(path) >= sizeof(addr->sun_path))
+        return false;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+// only serve clients of the same user
+static bool check_peer(int sock) noexcept {
+#if defined(SO_PEERCRED)
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (::getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 || len != sizeof(cred))
+        return false;
+    return cred.uid == ::geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (::getpeereid(sock, &uid, &gid) != 0)
+        return false;
+    return uid == ::geteuid();
+#endif
+}
+
+// let recvmsg() fail with EAGAIN instead of blocking the server forever
+static bool set_receive_timeout(int sock, unsigned ms) noexcept {
+    struct timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    return ::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0;
+}
+
+static void close_fds(const int *fds, unsigned n) noexcept {
+    for (unsigned i = 0; i < n; i++)
+        if (fds[i] >= 0)
+            (void) ::close(fds[i]);
+}
+
+// read exactly len bytes; the three standard fds may come with any of them
+static bool receive_bytes(int sock, byte *buf, unsigned len, int fds[3]) noexcept {
+    while (len > 0) {
+        struct iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = len;
+        union {
+            char buf[CMSG_SPACE(3 * sizeof(int))];
+            struct cmsghdr align;
+        } u;
+        struct msghdr msg;
+        mem_clear(&msg);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = u.buf;
+        msg.msg_controllen = sizeof(u.buf);
+        ssize_t l = ::recvmsg(sock, &msg, 0);
+        if (l < 0 && errno == EINTR)
+            continue;
+        if (l <= 0)
+            return false;
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+                continue;
+            int tmp[3] = {-1, -1, -1};
+            const unsigned n = (unsigned) ((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            memcpy(tmp, CMSG_DATA(c), upx::umin(n, 3u) * sizeof(int));
+            if (n == 3 && fds[0] < 0)
+                memcpy(fds, tmp, sizeof(tmp));
+            else
+                close_fds(tmp, upx::umin(n, 3u)); // unexpected; do not leak them
+        }
+        if (msg.msg_flags & MSG_CTRUNC)
+            return false;
+        buf += l;
+        len -= (unsigned) l;
+    }
+    return true;
+}
+
+// receive the three standard fds, the cwd and the arguments; on success
+// argv[1..argc-1] and *cwd point into buf
+static bool receive_request(int sock, int fds[3], MemBuffer &buf, const char **cwd, char **argv,
+                            int *argc) {
+    fds[0] = fds[1] = fds[2] = -1;
+    byte hdr[4];
+    bool ok = receive_bytes(sock, hdr, 4, fds);
+    const unsigned req_len = ok ? get_le32(hdr) : 0;
+    ok = ok && req_len >= 4 && req_len <= MAX_REQUEST_SIZE;
+    MemBuffer req;
+    if (ok) {
+        req.alloc(req_len);
+        ok = receive_bytes(sock, req, req_len, fds);
+    }
+    ok = ok && fds[0] >= 0 && fds[1] >= 0 && fds[2] >= 0;
+    // copy the strings to buf, each one terminated by a NUL byte
+    int n = 0;
+    if (ok) {
+        buf.alloc(req_len);
+        char *out = (char *) buf.getVoidPtr();
+        for (unsigned pos = 0; ok && pos < req_len; n++) {
+            const unsigned l = req_len - pos >= 4 ? get_le32(req + pos) : UINT_MAX;
+            ok = n < MAX_ARGS && l <= req_len - pos - 4;
+            if (ok) {
+                memcpy(out, req + pos + 4, l);
+                out[l] = 0;
+                if (n == 0)
+                    *cwd = out;
+                else
+                    argv[n] = out;
+                out += l + 1;
+                pos += 4 + l;
+            }
+        }
+    }
+    if (!ok) {
+        close_fds(fds, 3);
+        fds[0] = fds[1] = fds[2] = -1;
+        return false;
+    }
+    *argc = n; // the cwd takes the place of argv[0]
+    argv[n] = nullptr;
+    return true;
+}
+
+// send the three standard fds, the cwd and the arguments
+static bool send_request(int sock, const int fds[3], const char *cwd, int argc,
+                         const char *const *argv) {
+    unsigned len = 4 + 4 + (unsigned) strlen(cwd);
+    for (int i = 0; i < argc; i++)
+        len += 4 + (unsigned) strlen(argv[i]);
+    MemBuffer req(len);
+    byte *p = req;
+    set_le32(p, len - 4);
+    p += 4;
+    for (int i = -1; i < argc; i++) {
+        const char *s = i < 0 ? cwd : argv[i];
+        const unsigned l = (unsigned) strlen(s);
+        set_le32(p, l);
+        memcpy(p + 4, s, l);
+        p += 4 + l;
+    }
+
+    struct iovec iov;
+    iov.iov_base = req.getVoidPtr();
+    iov.iov_len = len;
+    union {
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } u;
+    struct msghdr msg;
+    mem_clear(&msg);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = u.buf;
+    msg.msg_controllen = sizeof(u.buf);
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(c), fds, 3 * sizeof(int));
+    ssize_t l;
+    do
+        l = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+    while (l < 0 && errno == EINTR);
+    // the fds went with the first chunk; send what is left
+    for (unsigned done = l > 0 ? (unsigned) l : 0; l >= 0 && done < len;) {
+        l = ::send(sock, req + done, len - done, MSG_NOSIGNAL);
+        if (l > 0)
+            done += (unsigned) l;
+        else if (l == 0 || errno != EINTR)
+            l = -1;
+    }
+    return l >= 0;
+}
+
+// run one job with the client's cwd and standard fds
+static int serve_one(int sock) {
+    int fds[3];
+    MemBuffer buf;
+    const char *cwd = nullptr;
+    char *argv[MAX_ARGS + 1];
+    int argc = 0;
+    if (!receive_request(sock, fds, buf, &cwd, argv, &argc))
+        return EXIT_ERROR;
+    static char serve_argv0[] = "upx";
+    argv[0] = serve_argv0;
+
+    int ec = EXIT_ERROR;
+    int saved_fds[3];
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < 3; i++) {
+        saved_fds[i] = ::dup(i);
+        (void) ::dup2(fds[i], i);
+        (void) ::close(fds[i]);
+    }
+    int saved_cwd = ::open(".", O_RDONLY);
+    if (::chdir(cwd) == 0)
+        ec = upx_main_serve_job(argc, argv);
+    else
+        fprintf(stderr, "%s: %s: %s\n", progname, cwd, strerror(errno));
+    fflush(stdout);
+    fflush(stderr);
+    if (saved_cwd >= 0) {
+        (void) ::fchdir(saved_cwd);
+        (void) ::close(saved_cwd);
+    }
+    for (int i = 0; i < 3; i++) {
+        (void) ::dup2(saved_fds[i], i);
+        (void) ::close(saved_fds[i]);
+    }
+    return ec;
+}
+
+int upx_serve(const char *path) {
+    struct sockaddr_un addr;
+    if (!make_address(&addr, path)) {
+        fprintf(stderr, "%s: --serve: bad socket path '%s'\n", progname, path);
+        return EXIT_USAGE;
+    }
+    // a client that goes away must not kill the server
+    (void) ::signal(SIGPIPE, SIG_IGN);
+    int sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        fprintf(stderr, "%s: --serve: %s\n", progname, strerror(errno));
+        return EXIT_ERROR;
+    }
+    // replace a stale socket from an earlier server, but nothing else
+    struct stat st;
+    if (::lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        (void) ::unlink(path);
+    // only the owner may connect
+    const mode_t saved_umask = ::umask(0177);
+    const int r = ::bind(sock, (const struct sockaddr *) &addr, sizeof(addr));
+    (void) ::umask(saved_umask);
+    if (r != 0 || ::listen(sock, 16) != 0) {
+        fprintf(stderr, "%s: --serve: %s: %s\n", progname, path, strerror(errno));
+        (void) ::close(sock);
+        return EXIT_ERROR;
+    }
+    // jobs run one after the other: each one temporarily owns the cwd
+    // and the standard fds of this process
+    for (;;) {
+        int c = ::accept(sock, nullptr, nullptr);
+        if (c < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            fprintf(stderr, "%s: --serve: %s\n", progname, strerror(errno));
+            break;
+        }
+        if (!check_peer(c)) {
+            fprintf(stderr, "%s: --serve: rejected a client of another user\n", progname);
+            (void) ::close(c);
+            continue;
+        }
+        if (!set_receive_timeout(c, REQUEST_TIMEOUT_MS)) {
+            fprintf(stderr, "%s: --serve: %s\n", progname, strerror(errno));
+            (void) ::close(c);
+            continue;
+        }
+        const byte ec = (byte) serve_one(c);
+        (void) ::send(c, &ec, 1, MSG_NOSIGNAL);
+        (void) ::close(c);
+    }
+    (void) ::close(sock);
+    (void) ::unlink(path);
+    return EXIT_ERROR;
+}
+
+int upx_connect(const char *path, int argc, char **argv) {
+    struct sockaddr_un addr;
+    if (!make_address(&addr, path)) {
+        fprintf(stderr, "%s: --connect: bad socket path '%s'\n", progname, path);
+        return EXIT_USAGE;
+    }
+    char cwd[ACC_FN_PATH_MAX + 1];
+    if (::getcwd(cwd, sizeof(cwd)) == nullptr) {
+        fprintf(stderr, "%s: --connect: getcwd: %s\n", progname, strerror(errno));
+        return EXIT_ERROR;
+    }
+    size_t len = 4 + 4 + strlen(cwd);
+    for (int i = 0; i < argc; i++)
+        len += 4 + strlen(argv[i]);
+    if (len - 4 > MAX_REQUEST_SIZE || argc >= MAX_ARGS) {
+        fprintf(stderr, "%s: --connect: command line too long\n", progname);
+        return EXIT_USAGE;
+    }
+
+    int sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0 || ::connect(sock, (const struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "%s: --connect: %s: %s\n", progname, path, strerror(errno));
+        if (sock >= 0)
+            (void) ::close(sock);
+        return EXIT_ERROR;
+    }
+    const int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    fflush(stdout);
+    fflush(stderr);
+    byte ec = EXIT_ERROR;
+    if (!send_request(sock, fds, cwd, argc, argv)) {
+        fprintf(stderr, "%s: --connect: %s\n", progname, strerror(errno));
+    } else {
+        ssize_t l;
+        do
+            l = ::recv(sock, &ec, 1, 0);
+        while (l < 0 && errno == EINTR);
+        if (l != 1) {
+            fprintf(stderr, "%s: --connect: no reply from server\n", progname);
+            ec = EXIT_ERROR;
+        }
+    }
+    (void) ::close(sock);
+    return ec;
+}
+
+/*************************************************************************
+//
+**************************************************************************/
+
+TEST_CASE("serve request") {
+    int sv[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    CHECK(check_peer(sv[0]));
+    const int std_fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    const char *const args[] = {"-1", "", "a b", ""}; // empty arguments survive
+    CHECK(send_request(sv[0], std_fds, "/tmp", 4, args));
+    int fds[3];
+    MemBuffer buf;
+    const char *cwd = nullptr;
+    char *argv[MAX_ARGS + 1];
+    int argc = 0;
+    CHECK(receive_request(sv[1], fds, buf, &cwd, argv, &argc));
+    CHECK(argc == 5);
+    CHECK(strcmp(cwd, "/tmp") == 0);
+    CHECK((strcmp(argv[1], "-1") == 0 && argv[2][0] == 0 && strcmp(argv[3], "a b") == 0));
+    CHECK((argv[4][0] == 0 && argv[5] == nullptr));
+    CHECK((fds[0] >= 0 && fds[1] >= 0 && fds[2] >= 0));
+    close_fds(fds, 3);
+
+    // a truncated request gets rejected
+    byte bad[8];
+    set_le32(bad, 16);
+    set_le32(bad + 4, 100);
+    CHECK(::send(sv[0], bad, sizeof(bad), MSG_NOSIGNAL) == (ssize_t) sizeof(bad));
+    (void) ::shutdown(sv[0], SHUT_WR);
+    CHECK(!receive_request(sv[1], fds, buf, &cwd, argv, &argc));
+    (void) ::close(sv[0]);
+    (void) ::close(sv[1]);
+
+    // a client that stalls gets dropped after the receive timeout
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    CHECK(set_receive_timeout(sv[1], 10));
+    CHECK(::send(sv[0], bad, 2, MSG_NOSIGNAL) == 2);
+    CHECK(!receive_request(sv[1], fds, buf, &cwd, argv, &argc));
+    (void) ::close(sv[0]);
+    (void) ::close(sv[1]);
+}
+
+#else // WITH_SERVE
+
+int upx_serve(const char *path) {
+    UNUSED(path);
+    fprintf(stderr, "%s: --serve is not supported on this platform\n", progname);
+    return EXIT_USAGE;
+}
+
+int upx_connect(const char *path, int argc, char **argv) {
+    UNUSED(path);
+    UNUSED(argc);
+    UNUSED(argv);
+    fprintf(stderr, "%s: --connect is not supported on this platform\n", progname);
+    return EXIT_USAGE;
+}
+
+#endif // WITH_SERVE
+
+/* vim:set ts=4 sw=4 et: */
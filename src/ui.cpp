@@ -593,11 +593,21 @@ void UiPacker::uiFileInfoEnd() { uiUpdate(); }
 // util
 **************************************************************************/
 
+static upx_std_atomic(bool) ui_header_done;
+static upx_std_atomic(bool) ui_footer_done;
+
+/*static*/ void UiPacker::uiReset() {
+    total_files = 0;
+    total_files_done = 0;
+    total_c_len = total_u_len = total_fc_len = total_fu_len = 0;
+    ui_header_done = false;
+    ui_footer_done = false;
+}
+
 /*static*/ void UiPacker::uiHeader() {
-    static upx_std_atomic(bool) done;
-    if (done)
+    if (ui_header_done)
         return;
-    done = true;
+    ui_header_done = true;
     if (opt->cmd == CMD_TEST || opt->cmd == CMD_FILEINFO)
         return;
     if (opt->verbose >= 1) {
@@ -606,10 +616,9 @@ void UiPacker::uiFileInfoEnd() { uiUpdate(); }
 }
 
 /*static*/ void UiPacker::uiFooter(const char *t) {
-    static upx_std_atomic(bool) done;
-    if (done)
+    if (ui_footer_done)
         return;
-    done = true;
+    ui_footer_done = true;
     if (opt->verbose >= 1) {
         assert(total_files >= total_files_done);
         unsigned n1 = total_files;
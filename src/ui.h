@@ -78,6 +78,7 @@ protected:
 public:
     static void uiHeader();
     static void uiFooter(const char *n);
+    static void uiReset(); // forget all totals, e.g. for "upx --serve"
 
     int ui_pass = 0;
     int ui_total_passes = 0;
@@ -0,0 +1,59 @@
+/* upx_lib.h -- library interface, see UPX_CONFIG_BUILD_LIBRARY
+
+   This file is part of the UPX executable compressor.
+
+   Copyright (C) 1996-2024 Markus Franz Xaver Johannes Oberhumer
+   Copyright (C) 1996-2024 Laszlo Molnar
+   All Rights Reserved.
+
+   UPX and the UCL library are free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+   Markus F.X.J. Oberhumer              Laszlo Molnar
+   <markus@oberhumer.com>               <ezerotven+github@gmail.com>
+ */
+
+#pragma once
+
+#include "conf.h"
+#include "util/membuffer.h"
+
+/*************************************************************************
+// upx_lib - the upx sources built without main()
+//
+// Usage: call upx_lib_init() once, then fill in an Options struct
+// (reset() it first and set "cmd") and pass it to do_one_memory_file().
+// Note that reset() selects the command line default "verbose = 2";
+// set "verbose = 0" to keep the library silent.
+// Errors are reported by throwing a Throwable, see except.h.
+//
+// NOTE: calls are not reentrant - the packers use the global "opt", the
+//   UI totals and the console. Only a WITH_THREADS build serializes
+//   concurrent callers of do_one_memory_file(); otherwise the caller
+//   must not use upx_lib from several threads at once.
+**************************************************************************/
+
+// work.cpp
+
+// initialize the compression libraries, send console output to stderr
+// and make the global options quiet; returns 0 on success
+int upx_lib_init() noexcept;
+
+// run o->cmd on the in-memory file "in"; for CMD_COMPRESS and CMD_DECOMPRESS
+// the result is stored in "out" and its size is returned
+unsigned do_one_memory_file(const Options *o, const char *name, const upx_byte *in,
+                            size_t in_len, MemBuffer &out) may_throw;
+
+/* vim:set ts=4 sw=4 et: */
@@ -129,6 +129,7 @@ static_assert(sizeof(void *) == sizeof(long));
 #include <utility>
 // C++ system headers
 #include <algorithm>
+#include <chrono>
 #include <memory> // std::unique_ptr
 // C++ multithreading (UPX currently does not use multithreading)
 #if __STDC_NO_ATOMICS__
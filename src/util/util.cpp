@@ -507,6 +507,101 @@ TEST_CASE("upx_std_stable_sort") {
 #endif // C++20
 #endif // DEBUG
 
+// scatter pass of upx_radixsort(); the fixed-size variants let the compiler inline memcpy()
+template <size_t N>
+static void radixsort_scatter(byte *dst, const byte *src, size_t n, size_t off, size_t *count) {
+    for (size_t i = 0; i < n; i++, src += N)
+        upx_memcpy_inline(dst + N * count[src[off]]++, src, N);
+}
+static void radixsort_scatter(byte *dst, const byte *src, size_t n, size_t element_size,
+                              size_t off, size_t *count) {
+    for (size_t i = 0; i < n; i++, src += element_size)
+        memcpy(dst + element_size * count[src[off]]++, src, element_size);
+}
+
+// stable LSD radix sort; one counting pass plus one scatter pass per digit;
+// a digit where all elements agree is skipped
+void upx_radixsort(void *array, size_t n, size_t element_size, const byte *digits,
+                   unsigned ndigits) {
+    mem_size_assert(element_size, n); // check size
+    if (n < 2)
+        return;
+    byte *src = (byte *) array;
+    byte *dst = (byte *) ::malloc(mem_size(element_size, n));
+    assert(dst != nullptr);
+    byte *const tmp = dst;
+    for (unsigned d = 0; d < ndigits; d++) {
+        const size_t off = digits[d];
+        assert(off < element_size);
+        size_t count[256];
+        memset(count, 0, sizeof(count));
+        for (size_t i = 0; i < n; i++)
+            count[src[element_size * i + off]] += 1;
+        if (count[src[off]] == n) // all elements have the same digit
+            continue;
+        size_t sum = 0;
+        for (size_t k = 0; k < 256; k++) {
+            const size_t c = count[k];
+            count[k] = sum;
+            sum += c;
+        }
+        if (element_size == 4)
+            radixsort_scatter<4>(dst, src, n, off, count);
+        else if (element_size == 5)
+            radixsort_scatter<5>(dst, src, n, off, count);
+        else if (element_size == 8)
+            radixsort_scatter<8>(dst, src, n, off, count);
+        else
+            radixsort_scatter(dst, src, n, element_size, off, count);
+        byte *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != (byte *) array)
+        memcpy(array, src, element_size * n);
+    ::free(tmp);
+}
+
+// sort an array of LE32 and remove duplicates; returns the new number of elements
+unsigned upx_sort_unique_le32(void *array, unsigned n) {
+    static const byte le32_digits[4] = {0, 1, 2, 3};
+    upx_radixsort(array, n, 4, le32_digits, 4);
+    byte *const a = (byte *) array;
+    unsigned j = 0;
+    for (unsigned i = 0; i < n; i++) {
+        const unsigned v = get_le32(a + 4 * i);
+        if (j == 0 || v != get_le32(a + 4 * (j - 1)))
+            set_le32(a + 4 * j++, v);
+    }
+    return j;
+}
+
+#if !defined(DOCTEST_CONFIG_DISABLE) && DEBUG
+TEST_CASE("upx_radixsort") {
+    static const byte le32_digits[4] = {0, 1, 2, 3};
+    LE32 a[64];
+    for (unsigned i = 0; i < 64; i++)
+        a[i] = (i * 0x9e3779b1u) ^ (i & 3); // pseudo-random, with some duplicates in low bits
+    a[7] = a[3];
+    upx_radixsort(a, 64, sizeof(LE32), le32_digits, 4);
+    for (unsigned i = 1; i < 64; i++)
+        CHECK(a[i - 1] <= a[i]);
+    // stable: sort by byte 1 only, byte 0 keeps the input order
+    byte b[8][2] = {{0, 2}, {1, 1}, {2, 2}, {3, 0}, {4, 1}, {5, 0}, {6, 2}, {7, 1}};
+    static const byte digit1[1] = {1};
+    upx_radixsort(b, 8, 2, digit1, 1);
+    static const byte expected[8] = {3, 5, 1, 4, 7, 0, 2, 6};
+    for (unsigned i = 0; i < 8; i++)
+        CHECK(b[i][0] == expected[i]);
+    // upx_sort_unique_le32
+    LE32 c[6];
+    c[0] = 5, c[1] = 0x10000, c[2] = 5, c[3] = 0, c[4] = 0x10000, c[5] = 5;
+    CHECK(upx_sort_unique_le32(c, 6) == 3);
+    CHECK((c[0] == 0 && c[1] == 5 && c[2] == 0x10000));
+    CHECK(upx_sort_unique_le32(c, 0) == 0);
+}
+#endif
+
 /*************************************************************************
 // qsort() util
 **************************************************************************/
@@ -167,6 +167,14 @@ void upx_shellsort_memcpy(void *array, size_t n, size_t element_size, upx_compar
 template <size_t ElementSize>
 void upx_std_stable_sort(void *array, size_t n, upx_compare_func_t compare);
 
+// stable LSD radix sort; "digits" are the byte offsets within an element
+// which make up the sort key, from least to most significant byte;
+// O(n * ndigits) time, needs a temporary copy of the array
+void upx_radixsort(void *array, size_t n, size_t element_size, const byte *digits,
+                   unsigned ndigits);
+// sort an array of LE32 and remove duplicates; returns the new number of elements
+unsigned upx_sort_unique_le32(void *array, unsigned n);
+
 // #define UPX_CONFIG_USE_STABLE_SORT 1
 #if UPX_CONFIG_USE_STABLE_SORT
 // use std::stable_sort(); NOTE: requires that "element_size" is constexpr!
@@ -41,9 +41,11 @@
 #include <sys/stat.h>
 #endif
 #include "conf.h"
+#include "compress/compress.h"
 #include "file.h"
 #include "packmast.h"
 #include "ui.h"
+#include "upx_lib.h"
 #include "util/membuffer.h"
 
 #if USE_UTIMENSAT && defined(AT_FDCWD)
@@ -136,8 +138,10 @@ static void copy_file_contents(const char *iname, const char *oname, OpenMode om
             break;
         fo.write(buf, bytes);
     }
-    if (oname_timestamp != nullptr)
+    if (oname_timestamp != nullptr) {
+        fo.flush(); // else closex() would update the timestamp again
         set_fd_timestamp(fo.getFd(), oname_timestamp);
+    }
     fi.closex();
     fo.closex();
 }
@@ -207,13 +211,23 @@ static void copy_file_attributes(const XStat *xst, const char *oname, bool prese
 void do_one_file(const char *const iname, char *const oname) may_throw {
     oname[0] = 0; // make empty
 
+    // "-" reads the whole input from stdin into memory
+    const bool from_stdin = strcmp(iname, "-") == 0;
+    InputFile fi;
+    if (from_stdin && !fi.openStdin(opt->force ? true : false))
+        throwIOException("stdin is a terminal -- skipped");
+
     // check iname stat
     XStat xst = {};
     struct stat &st = xst.st;
+    int rr = 0;
+    if (from_stdin)
+        st = fi.st;
+    else
 #if HAVE_LSTAT
-    int rr = lstat(iname, &st);
+        rr = lstat(iname, &st);
 #else
-    int rr = stat(iname, &st);
+        rr = stat(iname, &st);
 #endif
     if (rr != 0) {
         if (errno == ENOENT)
@@ -253,10 +267,10 @@ void do_one_file(const char *const iname, char *const oname) may_throw {
     }
 
     // open input file
-    InputFile fi;
-    fi.sopen(iname, get_open_flags(RO_MUST_EXIST), SH_DENYWR);
+    if (!from_stdin)
+        fi.sopen(iname, get_open_flags(RO_MUST_EXIST), SH_DENYWR);
 
-    if (opt->preserve_timestamp) {
+    if (opt->preserve_timestamp && !from_stdin) {
 #if USE_SETFILETIME
         if (GetFileTime((HANDLE) _get_osfhandle(fi.getFd()), nullptr, &xst.ft_atime,
                         &xst.ft_mtime) == 0)
@@ -322,6 +336,8 @@ void do_one_file(const char *const iname, char *const oname) may_throw {
             // cannot rely on open() because of umask
             // int omode = st.st_mode | 0600;
             int omode = opt->preserve_mode ? 0600 : 0666; // affected by umask; only for O_CREAT
+            if (from_stdin)
+                omode = 0777; // no mode to preserve; like a linker, also affected by umask
             fo.sopen(tname, flags, shmode, omode);
             // open succeeded - now set oname[]
             strcpy(oname, tname);
@@ -344,8 +360,10 @@ void do_one_file(const char *const iname, char *const oname) may_throw {
         throwInternalError("invalid command");
 
     // copy time stamp
-    if (oname[0] && opt->preserve_timestamp && fo.isOpen())
+    if (oname[0] && opt->preserve_timestamp && fo.isOpen() && !from_stdin) {
+        fo.flush(); // else closex() would update the timestamp again
         set_fd_timestamp(fo.getFd(), &xst);
+    }
 
     // close files
     fi.closex();
@@ -385,7 +403,9 @@ void do_one_file(const char *const iname, char *const oname) may_throw {
     if (oname[0]) {
         oname[0] = 0; // done with oname
         const char *name = opt->output_name ? opt->output_name : iname;
-        if (copy_timestamp_only)
+        if (from_stdin) {
+            // nothing to copy: the stat of stdin describes a pipe, not a file
+        } else if (copy_timestamp_only)
             copy_file_attributes(&xst, name, false, false, opt->preserve_timestamp);
         else
             copy_file_attributes(&xst, name, opt->preserve_mode, opt->preserve_ownership,
@@ -395,6 +415,96 @@ void do_one_file(const char *const iname, char *const oname) may_throw {
     UiPacker::uiConfirmUpdate();
 }
 
+/*************************************************************************
+// library interface - init
+// upx_main() does the same codec setup for the upx executable
+**************************************************************************/
+
+int upx_lib_init() noexcept {
+    upx_compiler_sanity_check();
+    // like upx_main(): messages go to stderr, but the library stays quiet
+    con_term = stderr;
+    opt->verbose = 0;
+    int r = 0;
+#if (WITH_BZIP2)
+    r |= upx_bzip2_init();
+#endif
+    r |= upx_lzma_init();
+#if (WITH_NRV)
+    r |= upx_nrv_init();
+#endif
+    r |= upx_ucl_init();
+#if (WITH_ZLIB)
+    r |= upx_zlib_init();
+#endif
+#if (WITH_ZSTD)
+    r |= upx_zstd_init();
+#endif
+    return r;
+}
+
+/*************************************************************************
+// process one file in memory - library interface
+//
+// The input buffer is treated like a regular file named "name" (some
+// formats look at the extension); for CMD_COMPRESS and CMD_DECOMPRESS the
+// result is stored in "out" and its size is returned.
+// NOTE: the packers use the global "opt", the UI totals and the console,
+//   so calls are serialized
+**************************************************************************/
+
+unsigned do_one_memory_file(const Options *o, const char *name, const byte *in, size_t in_len,
+                            MemBuffer &out) may_throw {
+#if WITH_THREADS
+    static std::mutex memory_file_mutex;
+    std::lock_guard<std::mutex> lock(memory_file_mutex);
+#endif
+    if (in_len == 0)
+        throwIOException("empty file -- skipped");
+    if (in_len < 512)
+        throwIOException("file is too small -- skipped");
+    if (!mem_size_valid_bytes(in_len))
+        throwIOException("file is too large -- skipped");
+
+    Options local_options;
+    memcpy(&local_options, o, sizeof(local_options)); // struct copy
+    local_options.to_stdout = false;
+    local_options.output_name = nullptr;
+    // install local_options as the global "opt" for the duration of this call
+    struct OptGuard final {
+        Options *saved;
+        explicit OptGuard(Options *o) noexcept : saved(opt) { opt = o; }
+        ~OptGuard() noexcept { opt = saved; }
+    };
+    OptGuard opt_guard(&local_options);
+
+    InputFile fi;
+    fi.openMemory(name, in, in_len);
+    OutputFile fo;
+    unsigned out_len = 0;
+
+    PackMaster pm(&fi);
+    if (opt->cmd == CMD_COMPRESS || opt->cmd == CMD_DECOMPRESS) {
+        fo.openMemory(name);
+        if (opt->cmd == CMD_COMPRESS)
+            pm.pack(&fo);
+        else
+            pm.unpack(&fo);
+        out_len = fo.getMemory(out);
+    } else if (opt->cmd == CMD_TEST)
+        pm.test();
+    else if (opt->cmd == CMD_LIST)
+        pm.list();
+    else if (opt->cmd == CMD_FILEINFO)
+        pm.fileInfo();
+    else
+        throwInternalError("invalid command");
+
+    fi.closex();
+    fo.closex();
+    return out_len;
+}
+
 /*************************************************************************
 // process all files from the commandline
 **************************************************************************/